@@ -0,0 +1,175 @@
+#include "checksum.h"
+#include "crc8kernels.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define CRC32C_HARDWARE_AVAILABLE
+#endif
+
+namespace
+{
+using Crc16Arc = CrcEngine<uint16_t, 0x8005, true>;
+using Crc32 = CrcEngine<uint32_t, 0x04C11DB7, true, 0xFFFFFFFF, 0xFFFFFFFF>;
+using Crc32C = CrcEngine<uint32_t, 0x1EDC6F41, true, 0xFFFFFFFF, 0xFFFFFFFF>;
+using Crc64Xz = CrcEngine<uint64_t,
+                          0x42F0E1EBA9EA3693,
+                          true,
+                          0xFFFFFFFFFFFFFFFF,
+                          0xFFFFFFFFFFFFFFFF>;
+
+template <typename T>
+void storeBigEndian(T value, unsigned char* out)
+{
+    for (size_t i = 0; i < sizeof(T); i++)
+        out[i] = static_cast<unsigned char>(value >> (8 * (sizeof(T) - 1 - i)));
+}
+
+template <typename Engine>
+using Calculation = typename Engine::ResultType (*)(ConstDataIterator, size_t);
+
+template <typename Engine, Calculation<Engine> Calculate = Engine::calculate>
+void blocksKernel(ConstDataIterator data, size_t blockSize, size_t blocksCount, unsigned char* out)
+{
+    using T = typename Engine::ResultType;
+    for (size_t i = 0; i < blocksCount; i++, data += blockSize, out += sizeof(T))
+        storeBigEndian(Calculate(data, blockSize), out);
+}
+
+template <typename Engine, Calculation<Engine> Calculate = Engine::calculate>
+void zeroPaddedBlockKernel(ConstDataIterator data,
+                           size_t dataSize,
+                           size_t blockSize,
+                           unsigned char* out)
+{
+    assert(dataSize <= blockSize);
+    storeBigEndian(Engine::extendByZeros(Calculate(data, dataSize), blockSize - dataSize), out);
+}
+
+void crc8ZeroPaddedBlockKernel(ConstDataIterator data,
+                               size_t dataSize,
+                               size_t blockSize,
+                               unsigned char* out)
+{
+    assert(dataSize <= blockSize);
+    static const Crc8Kernel kernel = fastestCrc8Kernel().kernel;
+    *out = crc8Combine(kernel({data, data + dataSize}, 0), 0, blockSize - dataSize);
+}
+
+void crc32cBlocksKernel(ConstDataIterator data,
+                        size_t blockSize,
+                        size_t blocksCount,
+                        unsigned char* out)
+{
+    static const auto kernel = isCrc32cHardwareSupported() ? blocksKernel<Crc32C, crc32cHardware>
+                                                           : blocksKernel<Crc32C>;
+    kernel(data, blockSize, blocksCount, out);
+}
+
+void crc32cZeroPaddedBlockKernel(ConstDataIterator data,
+                                 size_t dataSize,
+                                 size_t blockSize,
+                                 unsigned char* out)
+{
+    static const auto kernel = isCrc32cHardwareSupported()
+                                   ? zeroPaddedBlockKernel<Crc32C, crc32cHardware>
+                                   : zeroPaddedBlockKernel<Crc32C>;
+    kernel(data, dataSize, blockSize, out);
+}
+} // namespace
+
+#ifdef CRC32C_HARDWARE_AVAILABLE
+__attribute__((target("sse4.2"))) uint32_t crc32cHardware(ConstDataIterator data, size_t size)
+{
+    uint64_t crc = 0xFFFFFFFF;
+    for (; size >= sizeof(uint64_t); size -= sizeof(uint64_t), data += sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc = _mm_crc32_u64(crc, word);
+    }
+
+    auto crc32 = static_cast<uint32_t>(crc);
+    for (; size != 0; size--, data++)
+        crc32 = _mm_crc32_u8(crc32, *data);
+    return ~crc32;
+}
+
+bool isCrc32cHardwareSupported()
+{
+    return __builtin_cpu_supports("sse4.2");
+}
+#else
+uint32_t crc32cHardware(ConstDataIterator data, size_t size)
+{
+    return Crc32C::calculate(data, size);
+}
+
+bool isCrc32cHardwareSupported()
+{
+    return false;
+}
+#endif
+
+const std::vector<ChecksumInfo>& availableChecksums()
+{
+    static const std::vector<ChecksumInfo> checksums{
+        {ChecksumAlgorithm::Crc8,
+         "crc8",
+         sizeof(Crc8ResultType),
+         crc8GenericBlocks,
+         crc8ZeroPaddedBlockKernel},
+        {ChecksumAlgorithm::Crc16,
+         "crc16",
+         sizeof(Crc16Arc::ResultType),
+         blocksKernel<Crc16Arc>,
+         zeroPaddedBlockKernel<Crc16Arc>},
+        {ChecksumAlgorithm::Crc32,
+         "crc32",
+         sizeof(Crc32::ResultType),
+         blocksKernel<Crc32>,
+         zeroPaddedBlockKernel<Crc32>},
+        {ChecksumAlgorithm::Crc32C,
+         "crc32c",
+         sizeof(Crc32C::ResultType),
+         crc32cBlocksKernel,
+         crc32cZeroPaddedBlockKernel},
+        {ChecksumAlgorithm::Crc64,
+         "crc64",
+         sizeof(Crc64Xz::ResultType),
+         blocksKernel<Crc64Xz>,
+         zeroPaddedBlockKernel<Crc64Xz>}};
+    return checksums;
+}
+
+ChecksumBlocksKernel checksumBlocksKernelFor(ChecksumAlgorithm algorithm, size_t blockSize)
+{
+    if (algorithm == ChecksumAlgorithm::Crc8)
+        return crc8BlocksKernelFor(blockSize);
+    return checksumInfo(algorithm).blocksKernel;
+}
+
+const ChecksumInfo& checksumInfo(ChecksumAlgorithm algorithm)
+{
+    const auto& checksums = availableChecksums();
+    const auto it = std::find_if(checksums.begin(), checksums.end(), [&](const auto& info) {
+        return info.algorithm == algorithm;
+    });
+    if (it == checksums.end())
+        throw std::logic_error("unknown checksum algorithm");
+    return *it;
+}
+
+std::optional<ChecksumAlgorithm> checksumAlgorithmByName(std::string_view name)
+{
+    const auto& checksums = availableChecksums();
+    const auto it = std::find_if(
+        checksums.begin(), checksums.end(), [&](const auto& info) { return info.name == name; });
+    if (it == checksums.end())
+        return std::nullopt;
+    return it->algorithm;
+}
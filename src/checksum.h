@@ -0,0 +1,171 @@
+#pragma once
+
+#include "defs.h"
+
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+enum class ChecksumAlgorithm
+{
+    Crc8,
+    Crc16,
+    Crc32,
+    Crc32C,
+    Crc64
+};
+
+namespace CrcEngineDetails
+{
+template <typename T>
+constexpr T reflect(T value)
+{
+    T result = 0;
+    for (size_t i = 0; i < sizeof(T) * 8; i++, value = static_cast<T>(value >> 1))
+        result = static_cast<T>((result << 1) | (value & 1));
+    return result;
+}
+
+template <typename T, T Polynomial, bool Reflected>
+constexpr std::array<T, 256> makeTable()
+{
+    constexpr size_t width = sizeof(T) * 8;
+    constexpr T topBit = static_cast<T>(T{1} << (width - 1));
+
+    std::array<T, 256> table{};
+    for (unsigned byte = 0; byte < table.size(); byte++)
+    {
+        T crc = 0;
+        if constexpr (Reflected)
+        {
+            crc = static_cast<T>(byte);
+            for (int bit = 0; bit < 8; bit++)
+                crc = static_cast<T>((crc & 1) ? (crc >> 1) ^ reflect(Polynomial) : crc >> 1);
+        }
+        else
+        {
+            crc = static_cast<T>(T{static_cast<unsigned char>(byte)} << (width - 8));
+            for (int bit = 0; bit < 8; bit++)
+                crc = static_cast<T>((crc & topBit) ? (crc << 1) ^ Polynomial : crc << 1);
+        }
+        table[byte] = crc;
+    }
+    return table;
+}
+
+// NOTE: a * b mod P(x) for polynomials in the normal (not reflected) form
+template <typename T, T Polynomial>
+constexpr T multiplyMod(T a, T b)
+{
+    constexpr T topBit = static_cast<T>(T{1} << (sizeof(T) * 8 - 1));
+
+    T result = 0;
+    for (T bit = topBit; bit != 0; bit = static_cast<T>(bit >> 1))
+    {
+        result = static_cast<T>((result & topBit) ? (result << 1) ^ Polynomial : result << 1);
+        if (b & bit)
+            result ^= a;
+    }
+    return result;
+}
+
+// NOTE: x^(8 * bytesCount) mod P(x) by square-and-multiply
+template <typename T, T Polynomial>
+constexpr T xPowBytesMod(uintmax_t bytesCount)
+{
+    T square = 1;
+    for (int i = 0; i < 8; i++)
+        square = multiplyMod<T, Polynomial>(square, 2);
+
+    T result = 1;
+    for (; bytesCount != 0; bytesCount >>= 1)
+    {
+        if (bytesCount & 1)
+            result = multiplyMod<T, Polynomial>(result, square);
+        square = multiplyMod<T, Polynomial>(square, square);
+    }
+    return result;
+}
+} // namespace CrcEngineDetails
+
+// NOTE: Table-driven CRC of any width from 8 to 64 bits. Reflected CRCs process bits of every byte
+// starting from the least significant one, their Polynomial and Init are given in the normal form
+template <typename T, T Polynomial, bool Reflected, T Init = 0, T XorOut = 0>
+class CrcEngine
+{
+public:
+    using ResultType = T;
+    static constexpr size_t Width = sizeof(T) * 8;
+
+    static constexpr T calculate(ConstDataIterator data, size_t size)
+    {
+        T crc = Reflected ? CrcEngineDetails::reflect(Init) : Init;
+        for (size_t i = 0; i < size; i++)
+        {
+            if constexpr (Reflected)
+                crc = static_cast<T>(Table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8));
+            else
+                crc = static_cast<T>(Table[((crc >> (Width - 8)) ^ data[i]) & 0xFF] ^ (crc << 8));
+        }
+        return static_cast<T>(crc ^ XorOut);
+    }
+
+    // NOTE: CRC of the data followed by zerosCount zero bytes, calculated from CRC of the data in
+    // O(log(zerosCount)). Appending a zero byte multiplies the CRC register by x^8 mod P(x)
+    static constexpr T extendByZeros(T crc, uintmax_t zerosCount)
+    {
+        using namespace CrcEngineDetails;
+
+        T crcRegister = static_cast<T>(crc ^ XorOut);
+        if constexpr (Reflected)
+            crcRegister = reflect(crcRegister);
+        crcRegister = multiplyMod<T, Polynomial>(crcRegister,
+                                                 xPowBytesMod<T, Polynomial>(zerosCount));
+        if constexpr (Reflected)
+            crcRegister = reflect(crcRegister);
+        return static_cast<T>(crcRegister ^ XorOut);
+    }
+
+private:
+    static constexpr std::array<T, 256> Table =
+        CrcEngineDetails::makeTable<T, Polynomial, Reflected>();
+};
+
+// NOTE: Hashes blocksCount adjacent blocks of blockSize bytes and writes one digest per block to
+// `out`. Digests are written in big-endian order
+using ChecksumBlocksKernel = void (*)(ConstDataIterator data,
+                                      size_t blockSize,
+                                      size_t blocksCount,
+                                      unsigned char* out);
+
+// NOTE: Writes the digest of a block whose first dataSize bytes are `data` and the rest up to
+// blockSize are zeroes. The zeroes are not read, their contribution is calculated
+using ChecksumZeroPaddedBlockKernel = void (*)(ConstDataIterator data,
+                                               size_t dataSize,
+                                               size_t blockSize,
+                                               unsigned char* out);
+
+struct ChecksumInfo
+{
+    ChecksumAlgorithm algorithm;
+    std::string_view name;
+    size_t digestSize;
+    ChecksumBlocksKernel blocksKernel;
+    ChecksumZeroPaddedBlockKernel zeroPaddedBlockKernel;
+};
+
+const std::vector<ChecksumInfo>& availableChecksums();
+
+// NOTE: Like crc8BlocksKernelFor(), may return a kernel specialised for the block size, so it must
+// be used only for blocks of the given size
+ChecksumBlocksKernel checksumBlocksKernelFor(ChecksumAlgorithm algorithm, size_t blockSize);
+
+const ChecksumInfo& checksumInfo(ChecksumAlgorithm algorithm);
+std::optional<ChecksumAlgorithm> checksumAlgorithmByName(std::string_view name);
+
+// NOTE: CRC-32C with the SSE4.2 crc32 instruction. Must be called only if isCrc32cHardwareSupported()
+// returns true
+uint32_t crc32cHardware(ConstDataIterator data, size_t size);
+bool isCrc32cHardwareSupported();
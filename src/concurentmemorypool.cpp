@@ -1,38 +1,95 @@
 #include "concurentmemorypool.h"
 
+#include <cassert>
+#include <new>
+
 namespace
 {
-constexpr auto AcceptableQuantityOfAlloacationsFailing = 10'000;
-}
+// NOTE: Initial size of the lock-free list's node storage, it grows when needed
+constexpr size_t InitialFreeListCapacity = 64;
+} // namespace
 
 namespace Parallel
 {
-void* LazyMemoryPool::allocate(size_t n)
+void* allocateAligned(size_t n)
+{
+    if (n < DirectIoAlignment)
+        return operator new(n);
+    return operator new(n, std::align_val_t(DirectIoAlignment));
+}
+
+void deallocateAligned(void* memory, size_t n) noexcept
+{
+    if (n < DirectIoAlignment)
+        operator delete(memory);
+    else
+        operator delete(memory, std::align_val_t(DirectIoAlignment));
+}
+
+LazyMemoryPool::LazyMemoryPool(MemoryBudgetPtr budget, MemoryArenaPtr arena)
+    : budget_(std::move(budget))
+    , arena_(std::move(arena))
+    , freeChunks_(InitialFreeListCapacity)
 {
-    std::call_once(poolInitialisationFlag_, [this, n]() {
-        pool_ = std::make_unique<boost::pool<>>(n);
-        chunkSize_ = n;
-    });
+}
 
+LazyMemoryPool::~LazyMemoryPool()
+{
+    for (auto* chunk : systemChunks_)
+        deallocateAligned(chunk, chunkSize_);
+}
+
+void* LazyMemoryPool::allocate(size_t n)
+{
+    std::call_once(poolInitialisationFlag_, [this, n]() { chunkSize_ = n; });
     assert(chunkSize_ == n);
+
+    if (budget_)
+        budget_->acquire(chunkSize_);
+
     void* chunk = nullptr;
-    for (size_t i = 0; i < AcceptableQuantityOfAlloacationsFailing; i++)
+    if (freeChunks_.pop(chunk))
+        return chunk;
+
+    try
     {
-        std::lock_guard<std::mutex> lk(mut_);
-        chunk = pool_->malloc();
-        if (chunk)
-            break;
+        return allocateFromSystem();
+    }
+    catch (...)
+    {
+        if (budget_)
+            budget_->release(chunkSize_);
+        throw;
     }
-
-    if (!chunk)
-        throw std::bad_alloc();
-
-    return chunk;
 }
 
 void LazyMemoryPool::deallocate(void* chunk)
 {
-    std::lock_guard<std::mutex> lk(mut_);
-    pool_->free(chunk);
+    freeChunks_.push(chunk);
+    if (budget_)
+        budget_->release(chunkSize_);
 }
+
+void* LazyMemoryPool::allocateFromSystem()
+{
+    if (arena_)
+    {
+        if (auto* chunk = arena_->allocate(chunkSize_))
+            return chunk;
+    }
+
+    auto* chunk = allocateAligned(chunkSize_);
+    try
+    {
+        std::lock_guard<std::mutex> lk(systemChunksMut_);
+        systemChunks_.push_back(chunk);
+    }
+    catch (...)
+    {
+        deallocateAligned(chunk, chunkSize_);
+        throw;
+    }
+    return chunk;
+}
+
 } // namespace Parallel
@@ -1,27 +1,53 @@
 #pragma once
 
-#include <condition_variable>
+#include "defs.h"
+#include "memoryarena.h"
+#include "memorybudget.h"
+
 #include <memory>
 #include <mutex>
+#include <vector>
 
-#include <boost/pool/pool_alloc.hpp>
+#include <boost/lockfree/stack.hpp>
 
 namespace Parallel
 {
+// NOTE: Pool of equally sized chunks, the size is set by the first allocation. Freed chunks are
+// shared by all threads through a lock-free free list, so neither allocation nor deallocation takes
+// a lock. The chunks in use are charged to the budget and allocate() waits while it's exhausted, so
+// the pool never holds more memory in use than the budget allows. Free chunks aren't cached by
+// threads: a chunk held by one thread couldn't be reused by others, which would then allocate new
+// chunks over the budget. New chunks are taken from the arena while it has space, then from the heap
+// NOTE: Memory of DirectIoAlignment bytes and more is aligned to it, as the chunks of an arena are,
+// so data frames may be read with O_DIRECT wherever their memory comes from
+void* allocateAligned(size_t n);
+void deallocateAligned(void* memory, size_t n) noexcept;
+
 class LazyMemoryPool
 {
 public:
-    LazyMemoryPool() = default;
+    explicit LazyMemoryPool(MemoryBudgetPtr budget = nullptr, MemoryArenaPtr arena = nullptr);
+    LazyMemoryPool(const LazyMemoryPool&) = delete;
+    LazyMemoryPool& operator=(const LazyMemoryPool&) = delete;
+    ~LazyMemoryPool();
 
     void* allocate(size_t n);
     void deallocate(void* chunk);
 
 private:
-    mutable std::mutex mut_;
+    void* allocateFromSystem();
+
+private:
+    const MemoryBudgetPtr budget_;
+    const MemoryArenaPtr arena_;
+
     std::once_flag poolInitialisationFlag_;
-    std::unique_ptr<boost::pool<>> pool_;
-    std::condition_variable poolCond_;
-    size_t chunkSize_;
+    size_t chunkSize_ = 0;
+    boost::lockfree::stack<void*> freeChunks_;
+
+    // NOTE: All the heap chunks are released only with the pool
+    std::mutex systemChunksMut_;
+    std::vector<void*> systemChunks_;
 };
 using LazyMemoryPoolPtr = std::shared_ptr<LazyMemoryPool>;
 } // namespace Parallel
@@ -1,58 +1,252 @@
 #pragma once
 
-#include <chrono>
-#include <condition_variable>
+#include "futex.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdint>
+#include <iterator>
 #include <memory>
-#include <mutex>
-#include <queue>
+#include <new>
+#include <type_traits>
 
 namespace Parallel
 {
-template <typename T>
+// NOTE: Bounded lock-free ring buffer. Elements are stored inline and moved in and out, every cell
+// has a sequence number telling whether it's ready for a push or for a pop (D. Vyukov's bounded
+// MPMC queue). Threads block only when the queue is full or empty, by waiting on a futex.
+// A queue with a single producer or a single consumer skips the compare-and-swap on its side, the
+// caller guarantees that only one thread at a time pushes or pops then.
+// The bulk operations move several elements with one compare-and-swap and one wake-up, which
+// matters when the elements are small frames and synchronisation is a noticeable part of the work.
+// close() ends the stream: the elements already pushed are still popped, after that waitAndPop()
+// returns false at once. Pushing to a closed queue fails, so producers stop when a consumer fails
+// and the queues are closed
+template <typename T, bool IsSingleProducer = false, bool IsSingleConsumer = false>
 class Queue
 {
-    using milliseconds = std::chrono::milliseconds;
 public:
-    Queue(size_t maxSize = 0)
-        : maxSize_(maxSize){};
+    static constexpr size_t DefaultCapacity = 1024;
 
-    bool waitAndPop(T& value, const milliseconds timeToWait = milliseconds(0))
+    // NOTE: The capacity is rounded up to a power of two
+    explicit Queue(size_t capacity = DefaultCapacity)
+        : mask_(roundUpToPowerOfTwo(std::max<size_t>(capacity, 2)) - 1)
+        , cells_(std::make_unique<Cell[]>(mask_ + 1))
     {
-        std::unique_lock<std::mutex> lk(mut_);
-        if (!pushCond_.wait_for(lk, timeToWait, [this] { return !dataQueue_.empty(); }))
-            return false;
-        value = std::move(*dataQueue_.front());
-        dataQueue_.pop();
-        popCond_.notify_one();
-        return true;
+        for (size_t i = 0; i <= mask_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    Queue(const Queue&) = delete;
+    Queue& operator=(const Queue&) = delete;
+
+    ~Queue()
+    {
+        T value;
+        while (tryPop(value))
+            ;
+    }
+
+    // NOTE: Returns false when the queue is closed and empty
+    bool waitAndPop(T& value)
+    {
+        return waitAndPopBulk(&value, 1) != 0;
     }
 
     bool tryPop(T& value)
     {
-        std::lock_guard<std::mutex> lk(mut_);
-        if (dataQueue_.empty())
-            return false;
-        value = std::move(*dataQueue_.front());
-        dataQueue_.pop();
-        popCond_.notify_one();
+        return tryPopBulk(&value, 1) != 0;
+    }
+
+    // NOTE: Pops up to maxCount elements with one synchronisation, waiting only until the first
+    // of them is there. Returns 0 when the queue is closed and empty
+    template <typename OutputIterator>
+    size_t waitAndPopBulk(OutputIterator dest, size_t maxCount)
+    {
+        while (true)
+        {
+            const auto pushesCount = pushed_.load();
+            if (const auto count = tryPopBulk(dest, maxCount); count != 0)
+                return count;
+            // NOTE: The elements are pushed before the queue is closed, so they're visible here
+            if (isClosed_.load())
+                return tryPopBulk(dest, maxCount);
+            pushed_.wait(pushesCount);
+        }
+    }
+
+    template <typename OutputIterator>
+    size_t tryPopBulk(OutputIterator dest, size_t maxCount)
+    {
+        size_t pos = 0;
+        const auto count = claimCells<IsSingleConsumer>(dequeuePos_, 1, maxCount, pos);
+        for (size_t i = 0; i < count; i++)
+        {
+            auto& cell = cells_[(pos + i) & mask_];
+            auto* element = std::launder(reinterpret_cast<T*>(&cell.storage));
+            *dest = std::move(*element);
+            ++dest;
+            element->~T();
+            cell.sequence.store(pos + i + mask_ + 1, std::memory_order_release);
+        }
+        notify(popped_, count);
+        return count;
+    }
+
+    // NOTE: Returns false if the queue is closed, the value is dropped then
+    bool waitAndPush(T newValue)
+    {
+        return waitAndPushBulk(&newValue, &newValue + 1);
+    }
+
+    // NOTE: The value is moved from only if it's pushed
+    bool tryPush(T& value)
+    {
+        return tryPushBulk(&value, &value + 1) != &value;
+    }
+
+    // NOTE: Pushes the elements in order, as many at a time as there is place for. Returns false
+    // if the queue is closed, the elements not pushed yet are left as they are then
+    template <typename Iterator>
+    bool waitAndPushBulk(Iterator first, Iterator last)
+    {
+        while (first != last)
+        {
+            const auto popsCount = popped_.load();
+            if (isClosed_.load())
+                return false;
+            const auto pushedEnd = tryPushBulk(first, last);
+            if (pushedEnd == first)
+                popped_.wait(popsCount);
+            first = pushedEnd;
+        }
         return true;
     }
 
-    void waitAndPush(T newValue)
+    // NOTE: Returns the end of the elements pushed, only they are moved from
+    template <typename Iterator>
+    Iterator tryPushBulk(Iterator first, Iterator last)
+    {
+        size_t pos = 0;
+        const auto count = claimCells<IsSingleProducer>(
+            enqueuePos_, 0, static_cast<size_t>(std::distance(first, last)), pos);
+        for (size_t i = 0; i < count; i++, ++first)
+        {
+            auto& cell = cells_[(pos + i) & mask_];
+            new (&cell.storage) T(std::move(*first));
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        notify(pushed_, count);
+        return first;
+    }
+
+    void close()
     {
-        std::shared_ptr<T> data(std::make_shared<T>(std::move(newValue)));
-        std::unique_lock<std::mutex> lk(mut_);
-        if (maxSize_ != 0)
-            popCond_.wait(lk, [this] { return dataQueue_.size() < maxSize_; });
-        dataQueue_.push(data);
-        pushCond_.notify_one();
+        isClosed_.store(true);
+        pushed_.notifyAll();
+        popped_.notifyAll();
+    }
+
+    // NOTE: Closes the queue and drops the elements, so the memory budget they hold is released
+    // for the producers waiting on it. It's called by a consumer, e.g. when it fails
+    void abort()
+    {
+        close();
+        T value;
+        while (tryPop(value))
+            ;
+    }
+
+    bool isClosed() const noexcept
+    {
+        return isClosed_.load();
+    }
+
+    size_t capacity() const noexcept
+    {
+        return mask_ + 1;
     }
 
 private:
-    mutable std::mutex mut_;
-    const size_t maxSize_;
-    std::queue<std::shared_ptr<T>> dataQueue_;
-    std::condition_variable pushCond_;
-    std::condition_variable popCond_;
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        std::aligned_storage_t<sizeof(T), alignof(T)> storage;
+    };
+
+    // NOTE: Takes up to maxCount consecutive cells from the position on. A cell is ready when its
+    // sequence is its position plus the shift: 0 for pushing and 1 for popping. One compare-and-swap
+    // moves the position past all of them, that's what makes the bulk operations cheaper
+    template <bool IsSingleThread>
+    size_t claimCells(std::atomic<size_t>& position, size_t shift, size_t maxCount, size_t& first)
+    {
+        auto pos = position.load(std::memory_order_relaxed);
+        while (maxCount != 0)
+        {
+            size_t count = 0;
+            while (count < maxCount && cells_[(pos + count) & mask_].sequence.load(
+                                           std::memory_order_acquire) == pos + count + shift)
+            {
+                count++;
+            }
+
+            if (count == 0)
+            {
+                const auto sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+                if (static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + shift) < 0)
+                    return 0;
+                // NOTE: Another thread has taken the cell, or it has just got ready
+                pos = position.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if constexpr (IsSingleThread)
+            {
+                position.store(pos + count, std::memory_order_relaxed);
+            }
+            else if (!position.compare_exchange_weak(pos, pos + count, std::memory_order_relaxed))
+            {
+                continue;
+            }
+            first = pos;
+            return count;
+        }
+        return 0;
+    }
+
+    static void notify(Futex& futex, size_t count)
+    {
+        if (count == 1)
+            futex.notifyOne();
+        else if (count > 1)
+            futex.notifyAll();
+    }
+
+    static size_t roundUpToPowerOfTwo(size_t n)
+    {
+        size_t result = 1;
+        while (result < n)
+            result <<= 1;
+        return result;
+    }
+
+private:
+    // NOTE: The positions are on separate cache lines, producers and consumers don't share them
+    static constexpr size_t CacheLineSize = 64;
+
+    const size_t mask_;
+    const std::unique_ptr<Cell[]> cells_;
+    alignas(CacheLineSize) std::atomic<size_t> enqueuePos_ = 0;
+    alignas(CacheLineSize) std::atomic<size_t> dequeuePos_ = 0;
+    alignas(CacheLineSize) Futex pushed_;
+    alignas(CacheLineSize) Futex popped_;
+    std::atomic<bool> isClosed_ = false;
 };
+
+// NOTE: E.g. for the writer side of the pipeline, where many calculating tasks feed one writer
+template <typename T>
+using MpscQueue = Queue<T, false, true>;
+template <typename T>
+using SpscQueue = Queue<T, true, true>;
 } // namespace Parallel
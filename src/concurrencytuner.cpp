@@ -0,0 +1,75 @@
+#include "concurrencytuner.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace Parallel
+{
+ConcurrencyTuner::ConcurrencyTuner(Params params, Clock::time_point now)
+    : params_(params)
+    , concurrency_(std::clamp(
+          params.initialConcurrency, params.minConcurrency, params.maxConcurrency))
+    , windowBegin_(now)
+{
+    assert(params_.minConcurrency != 0 && params_.minConcurrency <= params_.maxConcurrency);
+}
+
+std::optional<size_t> ConcurrencyTuner::onProgress(size_t work,
+                                                   double occupancy,
+                                                   Clock::time_point now)
+{
+    std::lock_guard<std::mutex> lk(mut_);
+    windowWork_ += work;
+    const auto elapsed = std::chrono::duration<double>(now - windowBegin_);
+    if (now - windowBegin_ < params_.window || elapsed.count() <= 0)
+        return std::nullopt;
+
+    const auto throughput = static_cast<double>(windowWork_) / elapsed.count();
+    windowWork_ = 0;
+    windowBegin_ = now;
+
+    const auto concurrency = nextConcurrency(throughput, occupancy);
+    prevThroughput_ = throughput;
+    if (concurrency == concurrency_)
+        return std::nullopt;
+    concurrency_ = concurrency;
+    return concurrency;
+}
+
+std::optional<size_t> ConcurrencyTuner::onProgress(size_t work, double occupancy)
+{
+    return onProgress(work, occupancy, Clock::now());
+}
+
+size_t ConcurrencyTuner::concurrency() const
+{
+    std::lock_guard<std::mutex> lk(mut_);
+    return concurrency_;
+}
+
+size_t ConcurrencyTuner::nextConcurrency(double throughput, double occupancy)
+{
+    if (occupancy >= params_.maxOccupancy)
+        isGrowing_ = false;
+    else if (prevThroughput_ > 0)
+    {
+        // NOTE: A change within the noise isn't worth a step either way, so the number is held
+        const auto gain = throughput / prevThroughput_ - 1;
+        if (std::abs(gain) < params_.minGain)
+            return concurrency_;
+        // NOTE: The last step hasn't paid off, so the next one goes the other way
+        if (gain < 0)
+            isGrowing_ = !isGrowing_;
+    }
+
+    if (isGrowing_ && concurrency_ == params_.maxConcurrency)
+        isGrowing_ = false;
+    else if (!isGrowing_ && concurrency_ == params_.minConcurrency)
+        isGrowing_ = occupancy < params_.maxOccupancy;
+
+    if (isGrowing_)
+        return std::min(concurrency_ + 1, params_.maxConcurrency);
+    return std::max(concurrency_ - 1, params_.minConcurrency);
+}
+} // namespace Parallel
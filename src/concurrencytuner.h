@@ -0,0 +1,57 @@
+#pragma once
+
+#include <chrono>
+#include <mutex>
+#include <optional>
+
+namespace Parallel
+{
+// NOTE: Finds the number of workers of a stage which gives the best throughput by hill climbing:
+// every window of time the throughput is compared with the previous one, the number goes on in the
+// same direction while it grows, turns back when it drops and is held while it changes within the
+// noise. When the stage below can't keep up, i.e. the memory of the frames in flight is almost used
+// up, extra workers only wait for it, so the number goes down and the workers are left for the
+// stage below
+class ConcurrencyTuner
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    struct Params
+    {
+        size_t minConcurrency = 1;
+        size_t maxConcurrency;
+        size_t initialConcurrency;
+        Clock::duration window = std::chrono::milliseconds(100);
+        // NOTE: A smaller change of the throughput is taken for noise and doesn't move the number
+        double minGain = 0.05;
+        // NOTE: The share of the budget in use above which the stage below is the bottleneck
+        double maxOccupancy = 0.9;
+    };
+
+public:
+    explicit ConcurrencyTuner(Params params, Clock::time_point now = Clock::now());
+
+    // NOTE: Is called by the workers of the stage for every piece of work done, e.g. the bytes or
+    // frames read. Occupancy is the share of the downstream memory budget in use. Returns the new
+    // number of workers if it has been changed
+    std::optional<size_t> onProgress(size_t work, double occupancy, Clock::time_point now);
+    std::optional<size_t> onProgress(size_t work, double occupancy);
+
+    size_t concurrency() const;
+
+private:
+    size_t nextConcurrency(double throughput, double occupancy);
+
+private:
+    const Params params_;
+
+    mutable std::mutex mut_;
+    size_t concurrency_;
+    bool isGrowing_ = true;
+    // NOTE: Zero until the first window ends
+    double prevThroughput_ = 0;
+    size_t windowWork_ = 0;
+    Clock::time_point windowBegin_;
+};
+} // namespace Parallel
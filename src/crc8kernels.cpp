@@ -0,0 +1,413 @@
+#include "crc8kernels.h"
+#include "memorysizeliterals.h"
+
+#include <array>
+#include <cassert>
+#include <chrono>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define CRC8_CLMUL_AVAILABLE
+#define CRC8_CLMUL_TARGET __attribute__((target("pclmul,ssse3")))
+#endif
+
+namespace
+{
+constexpr std::array<unsigned char, 256> Crc8Table = {
+    0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
+    0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
+    0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
+    0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
+    0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
+    0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
+    0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
+    0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
+    0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
+    0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
+    0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
+    0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
+    0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
+    0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
+    0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
+    0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC};
+
+constexpr size_t MaxSlicingWidth = 16;
+using Crc8SlicingTables = std::array<std::array<unsigned char, 256>, MaxSlicingWidth>;
+
+// NOTE: CRC is linear, so the CRC of N bytes is a xor of N independent lookups. SlicingTables[k]
+// holds the contribution of a byte followed by k other bytes, i.e. Crc8Table applied k + 1 times
+constexpr Crc8SlicingTables makeCrc8SlicingTables()
+{
+    Crc8SlicingTables tables{};
+    tables[0] = Crc8Table;
+    for (size_t k = 1; k < MaxSlicingWidth; k++)
+    {
+        for (size_t i = 0; i < Crc8Table.size(); i++)
+            tables[k][i] = Crc8Table[tables[k - 1][i]];
+    }
+    return tables;
+}
+constexpr Crc8SlicingTables SlicingTables = makeCrc8SlicingTables();
+
+// NOTE: Kernels are templates on the size of the data. DynamicSize means the size is known only at
+// runtime, any other value lets the compiler unroll the loops for the size known at compile time
+constexpr size_t DynamicSize = 0;
+
+template <size_t N, size_t FixedSize = DynamicSize>
+Crc8ResultType crc8SlicingByN(ConstDataIterator data, size_t size, Crc8ResultType crc)
+{
+    static_assert(N > 0 && N <= MaxSlicingWidth);
+    if constexpr (FixedSize != DynamicSize)
+        size = FixedSize;
+
+    const auto chunksCount = size / N;
+#pragma GCC unroll 4
+    for (size_t chunk = 0; chunk < chunksCount; chunk++, data += N)
+    {
+        Crc8ResultType next = SlicingTables[N - 1][crc ^ data[0]];
+        for (size_t i = 1; i < N; i++)
+            next ^= SlicingTables[N - 1 - i][data[i]];
+        crc = next;
+    }
+
+    for (size_t i = 0; i < size % N; i++)
+        crc = Crc8Table[crc ^ data[i]];
+    return crc;
+}
+
+constexpr size_t InterleavedLanesCount = 8;
+
+constexpr uint64_t Crc8Polynomial = 0x131;
+
+// NOTE: a * b mod P(x), where a and b are polynomials of degree less than 8
+constexpr Crc8ResultType multiplyModCrc8Polynomial(Crc8ResultType a, Crc8ResultType b)
+{
+    uint64_t product = 0;
+    for (unsigned i = 0; i < 8; i++)
+    {
+        if ((b >> i) & 1)
+            product ^= uint64_t{a} << i;
+    }
+    for (unsigned bit = 14; bit >= 8; bit--)
+    {
+        if ((product >> bit) & 1)
+            product ^= Crc8Polynomial << (bit - 8);
+    }
+    return static_cast<Crc8ResultType>(product);
+}
+
+// NOTE: x^(8 * bytesCount) mod P(x) by square-and-multiply
+constexpr Crc8ResultType xPowBytesModCrc8Polynomial(uintmax_t bytesCount)
+{
+    Crc8ResultType result = 1;
+    Crc8ResultType square = static_cast<Crc8ResultType>((1u << 8) ^ Crc8Polynomial);
+    for (; bytesCount != 0; bytesCount >>= 1)
+    {
+        if (bytesCount & 1)
+            result = multiplyModCrc8Polynomial(result, square);
+        square = multiplyModCrc8Polynomial(square, square);
+    }
+    return result;
+}
+
+#ifdef CRC8_CLMUL_AVAILABLE
+constexpr size_t ClmulLanesCount = 4;
+constexpr size_t ClmulLaneSize = 16;
+constexpr size_t ClmulChunkSize = ClmulLanesCount * ClmulLaneSize;
+
+// NOTE: x^power mod P(x). Multiplying by it moves a polynomial `power` bits further from the end
+// of the message without changing its CRC
+constexpr uint64_t xPowModCrc8Polynomial(size_t power)
+{
+    uint64_t result = 1;
+    for (size_t i = 0; i < power; i++)
+    {
+        result <<= 1;
+        if (result & 0x100)
+            result ^= Crc8Polynomial;
+    }
+    return result;
+}
+
+struct FoldConstants
+{
+    uint64_t high;
+    uint64_t low;
+};
+
+constexpr FoldConstants makeFoldConstants(size_t distanceInBits)
+{
+    return {xPowModCrc8Polynomial(distanceInBits + 64), xPowModCrc8Polynomial(distanceInBits)};
+}
+
+constexpr FoldConstants ChunkFoldConstants = makeFoldConstants(ClmulChunkSize * 8);
+
+// NOTE: Moves every lane to the end of the last one, when the lanes are merged into a single value
+constexpr std::array<FoldConstants, ClmulLanesCount> makeLanesFoldConstants()
+{
+    std::array<FoldConstants, ClmulLanesCount> result{};
+    for (size_t i = 0; i < ClmulLanesCount; i++)
+        result[i] = makeFoldConstants((ClmulLanesCount - 1 - i) * ClmulLaneSize * 8);
+    return result;
+}
+constexpr auto LanesFoldConstants = makeLanesFoldConstants();
+
+CRC8_CLMUL_TARGET __m128i asVector(FoldConstants constants)
+{
+    return _mm_set_epi64x(static_cast<long long>(constants.high),
+                          static_cast<long long>(constants.low));
+}
+
+// NOTE: The constants are reduced modulo P(x), so the product stays below 72 bits and the folded
+// value is congruent to (lane * x^distance) rather than equal to it, which is all CRC needs
+CRC8_CLMUL_TARGET __m128i fold(__m128i lane, __m128i constants)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(lane, constants, 0x11),
+                         _mm_clmulepi64_si128(lane, constants, 0x00));
+}
+
+// NOTE: The CRC is calculated MSB first, so the first byte of a lane has to be the most significant
+CRC8_CLMUL_TARGET __m128i loadLane(ConstDataIterator data, __m128i byteReverseMask)
+{
+    return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)),
+                            byteReverseMask);
+}
+
+template <size_t FixedSize = DynamicSize>
+CRC8_CLMUL_TARGET Crc8ResultType crc8ClmulImpl(ConstDataIterator data,
+                                               size_t size,
+                                               Crc8ResultType crc)
+{
+    if constexpr (FixedSize != DynamicSize)
+        size = FixedSize;
+    if (size < ClmulChunkSize)
+        return crc8SlicingByN<16>(data, size, crc);
+
+    const auto byteReverseMask = _mm_set_epi8(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+    auto it = data;
+    const auto end = data + size;
+
+    __m128i lanes[ClmulLanesCount];
+    for (size_t i = 0; i < ClmulLanesCount; i++)
+        lanes[i] = loadLane(it + i * ClmulLaneSize, byteReverseMask);
+    const auto initialCrc = _mm_set_epi64x(static_cast<long long>(uint64_t{crc} << 56), 0);
+    lanes[0] = _mm_xor_si128(lanes[0], initialCrc);
+    it += ClmulChunkSize;
+
+    const auto chunkFoldConstants = asVector(ChunkFoldConstants);
+    for (; static_cast<size_t>(end - it) >= ClmulChunkSize; it += ClmulChunkSize)
+    {
+        for (size_t i = 0; i < ClmulLanesCount; i++)
+        {
+            lanes[i] = _mm_xor_si128(fold(lanes[i], chunkFoldConstants),
+                                     loadLane(it + i * ClmulLaneSize, byteReverseMask));
+        }
+    }
+
+    auto folded = lanes[ClmulLanesCount - 1];
+    for (size_t i = 0; i + 1 < ClmulLanesCount; i++)
+        folded = _mm_xor_si128(folded, fold(lanes[i], asVector(LanesFoldConstants[i])));
+
+    // NOTE: The folded value is congruent to the whole processed data, so CRC of its bytes is
+    // the CRC of the data
+    alignas(ClmulLaneSize) std::array<unsigned char, ClmulLaneSize> foldedBytes;
+    _mm_store_si128(reinterpret_cast<__m128i*>(foldedBytes.data()),
+                    _mm_shuffle_epi8(folded, byteReverseMask));
+    crc = crc8SlicingByN<16, ClmulLaneSize>(foldedBytes.data(), ClmulLaneSize, 0);
+
+    return crc8SlicingByN<16>(it, static_cast<size_t>(end - it), crc);
+}
+#endif
+
+template <size_t BlockSize, bool UseClmul>
+Crc8ResultType crc8OfFixedSize(ConstDataIterator data)
+{
+#ifdef CRC8_CLMUL_AVAILABLE
+    if constexpr (UseClmul)
+        return crc8ClmulImpl<BlockSize>(data, BlockSize, 0);
+#endif
+    return crc8SlicingByN<16, BlockSize>(data, BlockSize, 0);
+}
+
+template <size_t BlockSize, bool UseClmul>
+void crc8FixedSizeBlocks(ConstDataIterator data,
+                         [[maybe_unused]] size_t blockSize,
+                         size_t blocksCount,
+                         Crc8ResultType* out)
+{
+    assert(blockSize == BlockSize);
+    for (size_t i = 0; i < blocksCount; i++, data += BlockSize)
+        out[i] = crc8OfFixedSize<BlockSize, UseClmul>(data);
+}
+
+struct FixedSizeBlocksKernel
+{
+    size_t blockSize;
+    Crc8BlocksKernel kernel;
+};
+
+template <bool UseClmul>
+constexpr std::array<FixedSizeBlocksKernel, 4> FixedSizeBlocksKernels = {
+    {{512, crc8FixedSizeBlocks<512, UseClmul>},
+     {4 * KB, crc8FixedSizeBlocks<4 * KB, UseClmul>},
+     {64 * KB, crc8FixedSizeBlocks<64 * KB, UseClmul>},
+     {MB, crc8FixedSizeBlocks<MB, UseClmul>}}};
+
+constexpr size_t CalibrationDataSize = 64 * KB;
+constexpr size_t CalibrationRounds = 8;
+
+std::chrono::nanoseconds measure(const Crc8Kernel kernel, ConstDataRange data)
+{
+    using clock = std::chrono::steady_clock;
+
+    auto best = clock::duration::max();
+    for (size_t round = 0; round < CalibrationRounds; round++)
+    {
+        const auto start = clock::now();
+        [[maybe_unused]] volatile Crc8ResultType result = kernel(data, 0);
+        best = std::min(best, clock::now() - start);
+    }
+    return best;
+}
+
+const Crc8KernelInfo& calibrate()
+{
+    std::vector<unsigned char> data(CalibrationDataSize);
+    unsigned int seed = 1;
+    for (auto& byte : data)
+    {
+        seed = seed * 1103515245 + 12345;
+        byte = static_cast<unsigned char>(seed >> 16);
+    }
+    const ConstDataRange range{data.data(), data.data() + data.size()};
+
+    const auto& kernels = availableCrc8Kernels();
+    const Crc8KernelInfo* fastest = &kernels.front();
+    auto fastestTime = std::chrono::nanoseconds::max();
+    for (const auto& info : kernels)
+    {
+        assert(info.kernel(range, 0) == crc8Bytewise(range));
+        const auto time = measure(info.kernel, range);
+        if (time < fastestTime)
+        {
+            fastest = &info;
+            fastestTime = time;
+        }
+    }
+    return *fastest;
+}
+} // namespace
+
+Crc8ResultType crc8Bytewise(ConstDataRange range, Crc8ResultType crc)
+{
+    for (auto byte : range)
+        crc = Crc8Table[crc ^ byte];
+    return crc;
+}
+
+Crc8ResultType crc8SlicingBy8(ConstDataRange range, Crc8ResultType crc)
+{
+    return crc8SlicingByN<8>(range.begin(), range.size(), crc);
+}
+
+Crc8ResultType crc8SlicingBy16(ConstDataRange range, Crc8ResultType crc)
+{
+    return crc8SlicingByN<16>(range.begin(), range.size(), crc);
+}
+
+#ifdef CRC8_CLMUL_AVAILABLE
+Crc8ResultType crc8Clmul(ConstDataRange range, Crc8ResultType crc)
+{
+    return crc8ClmulImpl(range.begin(), range.size(), crc);
+}
+
+bool isCrc8ClmulSupported()
+{
+    return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("ssse3");
+}
+#else
+Crc8ResultType crc8Clmul(ConstDataRange range, Crc8ResultType crc)
+{
+    return crc8SlicingBy16(range, crc);
+}
+
+bool isCrc8ClmulSupported()
+{
+    return false;
+}
+#endif
+
+void crc8InterleavedBlocks(ConstDataIterator data,
+                           size_t blockSize,
+                           size_t blocksCount,
+                           Crc8ResultType* out)
+{
+    size_t block = 0;
+    for (; block + InterleavedLanesCount <= blocksCount; block += InterleavedLanesCount)
+    {
+        const auto lanesBegin = data + block * blockSize;
+        std::array<Crc8ResultType, InterleavedLanesCount> crcs{};
+        for (size_t byte = 0; byte < blockSize; byte++)
+        {
+            for (size_t lane = 0; lane < InterleavedLanesCount; lane++)
+                crcs[lane] = Crc8Table[crcs[lane] ^ lanesBegin[lane * blockSize + byte]];
+        }
+        std::copy(crcs.begin(), crcs.end(), out + block);
+    }
+
+    for (; block < blocksCount; block++)
+    {
+        const auto blockBegin = data + block * blockSize;
+        out[block] = crc8Bytewise({blockBegin, blockBegin + blockSize});
+    }
+}
+
+void crc8GenericBlocks(ConstDataIterator data,
+                       size_t blockSize,
+                       size_t blocksCount,
+                       Crc8ResultType* out)
+{
+    if (blockSize <= MaxInterleavedBlockSize)
+        return crc8InterleavedBlocks(data, blockSize, blocksCount, out);
+
+    static const Crc8Kernel kernel = fastestCrc8Kernel().kernel;
+    for (size_t i = 0; i < blocksCount; i++, data += blockSize)
+        out[i] = kernel({data, data + blockSize}, 0);
+}
+
+Crc8BlocksKernel crc8BlocksKernelFor(size_t blockSize)
+{
+    const auto& kernels = (fastestCrc8Kernel().kernel == crc8Clmul) ? FixedSizeBlocksKernels<true>
+                                                                    : FixedSizeBlocksKernels<false>;
+    for (const auto& fixedSizeKernel : kernels)
+    {
+        if (fixedSizeKernel.blockSize == blockSize)
+            return fixedSizeKernel.kernel;
+    }
+    return crc8GenericBlocks;
+}
+
+Crc8ResultType crc8Combine(Crc8ResultType crcA, Crc8ResultType crcB, uintmax_t lengthOfB)
+{
+    return multiplyModCrc8Polynomial(crcA, xPowBytesModCrc8Polynomial(lengthOfB)) ^ crcB;
+}
+
+const std::vector<Crc8KernelInfo>& availableCrc8Kernels()
+{
+    static const std::vector<Crc8KernelInfo> kernels = []() {
+        std::vector<Crc8KernelInfo> result{{"bytewise", crc8Bytewise},
+                                           {"slicing-by-8", crc8SlicingBy8},
+                                           {"slicing-by-16", crc8SlicingBy16}};
+        if (isCrc8ClmulSupported())
+            result.push_back({"clmul", crc8Clmul});
+        return result;
+    }();
+    return kernels;
+}
+
+const Crc8KernelInfo& fastestCrc8Kernel()
+{
+    static const Crc8KernelInfo& fastest = calibrate();
+    return fastest;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "defs.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+using Crc8ResultType = unsigned char;
+
+// NOTE: CRC-8-Dallas/Maxim. All the kernels calculate the same value and differ only in speed.
+// `crc` is the result for the data preceding the range, so a long range may be hashed piece by piece
+using Crc8Kernel = Crc8ResultType (*)(ConstDataRange range, Crc8ResultType crc);
+
+// NOTE: One table lookup per byte. It is the slowest kernel, but it is kept as the reference one
+Crc8ResultType crc8Bytewise(ConstDataRange range, Crc8ResultType crc = 0);
+Crc8ResultType crc8SlicingBy8(ConstDataRange range, Crc8ResultType crc = 0);
+Crc8ResultType crc8SlicingBy16(ConstDataRange range, Crc8ResultType crc = 0);
+
+// NOTE: Folds 64-byte chunks with carry-less multiplication (PCLMULQDQ) and reduces the folded
+// value with a table kernel. Must be called only if isCrc8ClmulSupported() returns true
+Crc8ResultType crc8Clmul(ConstDataRange range, Crc8ResultType crc = 0);
+bool isCrc8ClmulSupported();
+
+// NOTE: Hashes blocksCount adjacent blocks and writes one CRC per block to `out`. Several blocks are
+// hashed at once in interleaved lanes, so the per-byte lookup chains overlap. It is intended for
+// blocks of up to MaxInterleavedBlockSize bytes, where the per-block overhead of other kernels dominates
+constexpr size_t MaxInterleavedBlockSize = 32;
+void crc8InterleavedBlocks(ConstDataIterator data,
+                           size_t blockSize,
+                           size_t blocksCount,
+                           Crc8ResultType* out);
+
+// NOTE: Hashes blocksCount adjacent blocks of blockSize bytes and writes one CRC per block to `out`
+using Crc8BlocksKernel = void (*)(ConstDataIterator data,
+                                  size_t blockSize,
+                                  size_t blocksCount,
+                                  Crc8ResultType* out);
+
+// NOTE: Works for any block size. Short blocks are hashed with crc8InterleavedBlocks(), others one
+// by one with the fastest kernel
+void crc8GenericBlocks(ConstDataIterator data,
+                       size_t blockSize,
+                       size_t blocksCount,
+                       Crc8ResultType* out);
+
+// NOTE: Common block sizes (512B, 4KB, 64KB, 1MB) have kernels instantiated for the size at compile
+// time, so their loops have known trip counts. Other sizes get crc8GenericBlocks(). The returned
+// kernel must be used only for blocks of the given size
+Crc8BlocksKernel crc8BlocksKernelFor(size_t blockSize);
+
+// NOTE: CRC of data A followed by data B, calculated from CRCs of the parts in O(log(lengthOfB)).
+// It allows a long range to be split into segments hashed independently
+Crc8ResultType crc8Combine(Crc8ResultType crcA, Crc8ResultType crcB, uintmax_t lengthOfB);
+
+struct Crc8KernelInfo
+{
+    std::string_view name;
+    Crc8Kernel kernel;
+};
+
+const std::vector<Crc8KernelInfo>& availableCrc8Kernels();
+
+// NOTE: The kernel is chosen by a short calibration on the first call, the result is cached
+const Crc8KernelInfo& fastestCrc8Kernel();
@@ -1,79 +1,399 @@
 #include "crchasher.h"
 
+#include "memorysizeliterals.h"
+#include "numatopology.h"
+#include "utils.h"
+
 #include <boost/asio/post.hpp>
+#include <boost/thread/thread.hpp>
+
+#include <algorithm>
 
 namespace
 {
-constexpr std::array<unsigned char, 256> Crc8Table = {
-    0x00, 0x31, 0x62, 0x53, 0xC4, 0xF5, 0xA6, 0x97, 0xB9, 0x88, 0xDB, 0xEA, 0x7D, 0x4C, 0x1F, 0x2E,
-    0x43, 0x72, 0x21, 0x10, 0x87, 0xB6, 0xE5, 0xD4, 0xFA, 0xCB, 0x98, 0xA9, 0x3E, 0x0F, 0x5C, 0x6D,
-    0x86, 0xB7, 0xE4, 0xD5, 0x42, 0x73, 0x20, 0x11, 0x3F, 0x0E, 0x5D, 0x6C, 0xFB, 0xCA, 0x99, 0xA8,
-    0xC5, 0xF4, 0xA7, 0x96, 0x01, 0x30, 0x63, 0x52, 0x7C, 0x4D, 0x1E, 0x2F, 0xB8, 0x89, 0xDA, 0xEB,
-    0x3D, 0x0C, 0x5F, 0x6E, 0xF9, 0xC8, 0x9B, 0xAA, 0x84, 0xB5, 0xE6, 0xD7, 0x40, 0x71, 0x22, 0x13,
-    0x7E, 0x4F, 0x1C, 0x2D, 0xBA, 0x8B, 0xD8, 0xE9, 0xC7, 0xF6, 0xA5, 0x94, 0x03, 0x32, 0x61, 0x50,
-    0xBB, 0x8A, 0xD9, 0xE8, 0x7F, 0x4E, 0x1D, 0x2C, 0x02, 0x33, 0x60, 0x51, 0xC6, 0xF7, 0xA4, 0x95,
-    0xF8, 0xC9, 0x9A, 0xAB, 0x3C, 0x0D, 0x5E, 0x6F, 0x41, 0x70, 0x23, 0x12, 0x85, 0xB4, 0xE7, 0xD6,
-    0x7A, 0x4B, 0x18, 0x29, 0xBE, 0x8F, 0xDC, 0xED, 0xC3, 0xF2, 0xA1, 0x90, 0x07, 0x36, 0x65, 0x54,
-    0x39, 0x08, 0x5B, 0x6A, 0xFD, 0xCC, 0x9F, 0xAE, 0x80, 0xB1, 0xE2, 0xD3, 0x44, 0x75, 0x26, 0x17,
-    0xFC, 0xCD, 0x9E, 0xAF, 0x38, 0x09, 0x5A, 0x6B, 0x45, 0x74, 0x27, 0x16, 0x81, 0xB0, 0xE3, 0xD2,
-    0xBF, 0x8E, 0xDD, 0xEC, 0x7B, 0x4A, 0x19, 0x28, 0x06, 0x37, 0x64, 0x55, 0xC2, 0xF3, 0xA0, 0x91,
-    0x47, 0x76, 0x25, 0x14, 0x83, 0xB2, 0xE1, 0xD0, 0xFE, 0xCF, 0x9C, 0xAD, 0x3A, 0x0B, 0x58, 0x69,
-    0x04, 0x35, 0x66, 0x57, 0xC0, 0xF1, 0xA2, 0x93, 0xBD, 0x8C, 0xDF, 0xEE, 0x79, 0x48, 0x1B, 0x2A,
-    0xC1, 0xF0, 0xA3, 0x92, 0x05, 0x34, 0x67, 0x56, 0x78, 0x49, 0x1A, 0x2B, 0xBC, 0x8D, 0xDE, 0xEF,
-    0x82, 0xB3, 0xE0, 0xD1, 0x46, 0x77, 0x24, 0x15, 0x3B, 0x0A, 0x59, 0x68, 0xFF, 0xCE, 0x9D, 0xAC};
+// NOTE: Splitting smaller blocks costs more in synchronisation than it saves
+constexpr size_t MinSegmentSize = 4 * MB;
+
+size_t outputFrameCapacity(const DataFrameView& inFrame, size_t digestSize)
+{
+    return inFrame.blocksCapacity() * digestSize;
+}
+
+// NOTE: The capacity of the output frame follows the capacity of the input one rather than the
+// number of its blocks, so a short last frame gets a chunk of the same memory pool as others
+DataFrame makeOutputFrame(const DataFrameView& inFrame,
+                          Parallel::LazyMemoryPoolPtr memoryPool,
+                          size_t digestSize)
+{
+    DataFrame outFrame{{.firstBlockIdx = inFrame.firstBlockIndex(),
+                        .blockSize = digestSize,
+                        .blocksCount = inFrame.blocksCapacity(),
+                        .memoryPool = memoryPool,
+                        .isZeroFilled = false}};
+    outFrame.setBlocksCount(inFrame.blocksCount());
+    return outFrame;
+}
+
+// NOTE: Reserves the output memory of the whole batch if it fits and of a single frame otherwise
+std::optional<Parallel::MemoryBudget::Reservation> reserveOutputMemory(
+    Parallel::MemoryBudget& budget, size_t frameSize, size_t& framesCount)
+{
+    if (auto reservation = budget.tryReserve(framesCount * frameSize))
+        return reservation;
+    framesCount = 1;
+    return budget.tryReserve(frameSize);
+}
+
+// NOTE: More segments than cores can't be hashed at once
+size_t getMaxSegmentsCnt()
+{
+    return std::max(1u, boost::thread::hardware_concurrency());
+}
+
+struct Segment
+{
+    ConstDataRange range;
+    std::atomic<bool> isTaken = false;
+    std::promise<Crc8ResultType> result;
+};
+
+void calculateSegmentIfNotTaken(Segment& segment)
+{
+    if (!segment.isTaken.exchange(true))
+        segment.result.set_value(crc8(segment.range));
+}
+
+// NOTE: Splits blocks of the frame into runs of data blocks and runs of hole blocks
+template <typename OnDataBlocks, typename OnHoleBlocks>
+void forEachBlocksRun(const DataFrameView& frame,
+                      OnDataBlocks onDataBlocks,
+                      OnHoleBlocks onHoleBlocks)
+{
+    size_t begin = 0;
+    for (const auto& hole : frame.holes())
+    {
+        if (begin != hole.begin)
+            onDataBlocks(begin, hole.begin);
+        onHoleBlocks(hole.begin, hole.end);
+        begin = hole.end;
+    }
+    if (begin != frame.blocksCount())
+        onDataBlocks(begin, frame.blocksCount());
+}
+
+// NOTE: Every block of a hole is all zeroes, so the digest is calculated once and copied
+void fillHoleBlocksDigests(const DataFrameView& inFrame,
+                           DataFrame& outFrame,
+                           const ChecksumInfo& checksum,
+                           size_t begin,
+                           size_t end)
+{
+    const auto zeroBlockDigest = outFrame.blockAsRange(begin);
+    checksum.zeroPaddedBlockKernel(
+        inFrame.cbegin(), 0, inFrame.blockSize(), zeroBlockDigest.begin());
+    for (size_t i = begin + 1; i < end; i++)
+        std::copy(zeroBlockDigest.begin(), zeroBlockDigest.end(), outFrame.blockAsRange(i).begin());
+}
 } // namespace
 
 // NOTE: CRC-8-Dallas/Maxim
 Crc8ResultType crc8(ConstDataRange range)
 {
-    Crc8ResultType crc = 0;
-    for (auto byte : range)
-        crc = Crc8Table[crc ^ byte];
-    return crc;
+    static const Crc8Kernel kernel = fastestCrc8Kernel().kernel;
+    return kernel(range, 0);
 }
 
-DataFrame calculateCrc8OfFrame(const DataFrame& inFrame, Parallel::LazyMemoryPoolPtr memoryPool)
+DataFrame calculateCrc8OfFrame(const DataFrameView& inFrame,
+                               Parallel::LazyMemoryPoolPtr memoryPool)
 {
-    DataFrame outFrame{{.firstBlockIdx = inFrame.firstBlockIndex(),
-                        .blockSize = sizeof(Crc8ResultType),
-                        .blocksCount = inFrame.blocksCount(),
-                        .memoryPool = memoryPool}};
+    return calculateCrc8OfFrame(inFrame, memoryPool, crc8BlocksKernelFor(inFrame.blockSize()));
+}
 
-    for (size_t i = 0; i < inFrame.blocksCount(); i++)
-        *outFrame.blockAsRange(i).begin() = crc8(inFrame.blockAsRange(i));
+DataFrame calculateCrc8OfFrame(const DataFrameView& inFrame,
+                               Parallel::LazyMemoryPoolPtr memoryPool,
+                               Crc8BlocksKernel kernel)
+{
+    return calculateChecksumOfFrame(
+        inFrame, memoryPool, kernel, checksumInfo(ChecksumAlgorithm::Crc8));
+}
 
+DataFrame calculateChecksumOfFrame(const DataFrameView& inFrame,
+                                   Parallel::LazyMemoryPoolPtr memoryPool,
+                                   ChecksumBlocksKernel kernel,
+                                   const ChecksumInfo& checksum)
+{
+    auto outFrame = makeOutputFrame(inFrame, memoryPool, checksum.digestSize);
+    const auto onDataBlocks = [&](size_t begin, size_t end) {
+        const auto isLastBlockPadded = end == inFrame.blocksCount() && inFrame.paddingSize() != 0;
+        const auto fullBlocksEnd = isLastBlockPadded ? end - 1 : end;
+        kernel(inFrame.blockAsRange(begin).begin(),
+               inFrame.blockSize(),
+               fullBlocksEnd - begin,
+               outFrame.blockAsRange(begin).begin());
+        if (isLastBlockPadded)
+        {
+            checksum.zeroPaddedBlockKernel(inFrame.blockAsRange(fullBlocksEnd).begin(),
+                                           inFrame.blockSize() - inFrame.paddingSize(),
+                                           inFrame.blockSize(),
+                                           outFrame.blockAsRange(fullBlocksEnd).begin());
+        }
+    };
+    const auto onHoleBlocks = [&](size_t begin, size_t end) {
+        fillHoleBlocksDigests(inFrame, outFrame, checksum, begin, end);
+    };
+    forEachBlocksRun(inFrame, onDataBlocks, onHoleBlocks);
     return outFrame;
 }
 
+DataFrame calculateCrc8OfFrame(const DataFrame& inFrame, Parallel::LazyMemoryPoolPtr memoryPool)
+{
+    return calculateCrc8OfFrame(DataFrameView(inFrame), std::move(memoryPool));
+}
+
+DataFrame calculateChecksumOfFrame(const DataFrame& inFrame,
+                                   Parallel::LazyMemoryPoolPtr memoryPool,
+                                   ChecksumBlocksKernel kernel,
+                                   const ChecksumInfo& checksum)
+{
+    return calculateChecksumOfFrame(
+        DataFrameView(inFrame), std::move(memoryPool), kernel, checksum);
+}
+
 namespace Parallel
 {
+Crc8ResultType crc8(ConstDataRange range, size_t segmentsCount, boost::asio::thread_pool& pool)
+{
+    assert(segmentsCount != 0);
+    segmentsCount = std::min(segmentsCount, std::max<size_t>(range.size(), 1));
+
+    auto segments = std::make_shared<std::vector<Segment>>(segmentsCount);
+    std::vector<std::future<Crc8ResultType>> results;
+    const auto segmentSize = ceilDevision(range.size(), segmentsCount);
+    for (size_t i = 0; i < segmentsCount; i++)
+    {
+        auto& segment = segments->at(i);
+        const auto begin = std::min(i * segmentSize, range.size());
+        const auto end = std::min(begin + segmentSize, range.size());
+        segment.range = {range.begin() + begin, range.begin() + end};
+        results.push_back(segment.result.get_future());
+    }
+
+    for (size_t i = 1; i < segmentsCount; i++)
+        post(pool, [segments, i]() { calculateSegmentIfNotTaken(segments->at(i)); });
+    for (auto& segment : *segments)
+        calculateSegmentIfNotTaken(segment);
+
+    Crc8ResultType crc = 0;
+    for (size_t i = 0; i < segmentsCount; i++)
+        crc = crc8Combine(crc, results[i].get(), segments->at(i).range.size());
+    return crc;
+}
+
+DataFrame Crc8Wrapper::calculateFrame(const DataFrameView& inFrame,
+                                      LazyMemoryPoolPtr memoryPool,
+                                      const ChecksumInfo& checksum,
+                                      boost::asio::thread_pool* segmentsPool,
+                                      BlocksKernelCache& kernelCache)
+{
+    const auto segmentsCount =
+        segmentsPool ? std::min(inFrame.blockSize() / MinSegmentSize, getMaxSegmentsCnt()) : 1;
+    if (segmentsCount < 2 || checksum.algorithm != ChecksumAlgorithm::Crc8)
+    {
+        // NOTE: All the frames of a run have the same block size, so the kernel is chosen once
+        if (kernelCache.blockSize != inFrame.blockSize())
+        {
+            kernelCache = {inFrame.blockSize(),
+                           checksumBlocksKernelFor(checksum.algorithm, inFrame.blockSize())};
+        }
+        return calculateChecksumOfFrame(inFrame, memoryPool, kernelCache.kernel, checksum);
+    }
+
+    auto outFrame = makeOutputFrame(inFrame, memoryPool, sizeof(Crc8ResultType));
+    const auto onDataBlocks = [&](size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++)
+        {
+            auto block = inFrame.blockAsRange(i);
+            const auto paddingSize = i + 1 == inFrame.blocksCount() ? inFrame.paddingSize() : 0;
+            const auto crc =
+                crc8({block.begin(), block.end() - static_cast<ptrdiff_t>(paddingSize)},
+                     segmentsCount,
+                     *segmentsPool);
+            *outFrame.blockAsRange(i).begin() = crc8Combine(crc, 0, paddingSize);
+        }
+    };
+    const auto onHoleBlocks = [&](size_t begin, size_t end) {
+        fillHoleBlocksDigests(inFrame, outFrame, checksum, begin, end);
+    };
+    forEachBlocksRun(inFrame, onDataBlocks, onHoleBlocks);
+    return outFrame;
+}
+
+size_t Crc8Wrapper::batchSizeFor(size_t framesInFlight, size_t tasksCount)
+{
+    return std::clamp<size_t>(framesInFlight / (2 * std::max<size_t>(tasksCount, 1)),
+                              1,
+                              DefaultBatchSize);
+}
+
 void Crc8Wrapper::calculateForWholeQueue(CalculateForWholeQueueParams prms)
 {
-    assert(prms.tasksCount != 0);
+    assert(prms.tasksCount != 0 && prms.batchSize != 0);
 
-    LazyMemoryPoolPtr memoryPool;
     while (prms.tasksCount--)
     {
-        std::packaged_task<void()> calculationTask([&, prms, memoryPool]() {
-            DataFrame inFrame;
-            while (!prms.hasProducerFinished->load())
+        std::packaged_task<void()> calculationTask([this, prms]() {
+            ThreadPinning pinning(prms.cpus);
+            const CalculateFramesParams framesPrms{.src = prms.src,
+                                                   .dest = prms.dest,
+                                                   .checksum = prms.checksum,
+                                                   .outputBudget = prms.outputBudget,
+                                                   .batchSize = prms.batchSize,
+                                                   .segmentsPool = &prms.pool};
+            CalculationState state{.inFrames = std::vector<DataFrame>(prms.batchSize)};
+            size_t framesCount = 0;
+            while ((framesCount = prms.src.waitAndPopBulk(state.inFrames.begin(), prms.batchSize)))
             {
-                while (prms.src.waitAndPop(inFrame, std::chrono::milliseconds(100)))
-                    prms.dest.waitAndPush(calculateCrc8OfFrame(inFrame, memoryPool));
+                if (!calculateAndPush(framesPrms, framesCount, state))
+                    break;
             }
-            while (prms.src.tryPop(inFrame))
-                prms.dest.waitAndPush(calculateCrc8OfFrame(inFrame, memoryPool));
         });
         futures_.push_back(calculationTask.get_future());
         post(prms.pool, std::move(calculationTask));
     }
 }
 
+StepResult Crc8Wrapper::calculateFrames(const CalculateFramesParams& prms)
+{
+    assert(prms.batchSize != 0);
+
+    auto batchSize = prms.batchSize;
+    const auto isReserved = prms.outputBudget && prms.outputFrameSize != 0;
+    const auto reservation =
+        isReserved ? reserveOutputMemory(*prms.outputBudget, prms.outputFrameSize, batchSize)
+                   : std::nullopt;
+    if (isReserved && !reservation)
+        return StepResult::NoWork;
+
+    const auto state = takeState(batchSize);
+    auto framesCount = prms.src.tryPopBulk(state->inFrames.begin(), batchSize);
+    if (framesCount == 0)
+    {
+        // NOTE: The frames are pushed before the queue is closed, so none is left behind
+        if (!prms.src.isClosed())
+            return StepResult::NoWork;
+        framesCount = prms.src.tryPopBulk(state->inFrames.begin(), batchSize);
+        if (framesCount == 0)
+            return StepResult::Finished;
+    }
+    return calculateAndPush(prms, framesCount, *state) ? StepResult::Progress
+                                                       : StepResult::Finished;
+}
+
+bool Crc8Wrapper::calculateAndPush(const CalculateFramesParams& prms,
+                                   size_t framesCount,
+                                   CalculationState& state)
+{
+    const auto& checksum = checksumInfo(prms.checksum);
+    try
+    {
+        // NOTE: Every output frame is pushed as soon as it's ready. Holding the batch back could
+        // deadlock: its frames keep the output budget which the next frame of the batch waits for
+        for (size_t i = 0; i < framesCount; i++)
+        {
+            auto outFrame = calculateOutputFrame(DataFrameView(state.inFrames[i]),
+                                                 checksum,
+                                                 prms.outputBudget,
+                                                 prms.segmentsPool,
+                                                 state);
+            // NOTE: The input frame is released right away, otherwise its bytes stay charged to
+            // the budget while the task waits for the next frame
+            state.inFrames[i] = DataFrame();
+            if (!prms.dest.waitAndPush(std::move(outFrame)))
+            {
+                // NOTE: The consumer has failed, so the producers are stopped as well
+                prms.src.abort();
+                state.inFrames.clear();
+                return false;
+            }
+            if (prms.onPushed)
+                prms.onPushed();
+        }
+        return true;
+    }
+    catch (...)
+    {
+        // NOTE: The state is reused, so the frames left aren't kept charged to the budget
+        state.inFrames.clear();
+        prms.src.abort();
+        prms.dest.close();
+        throw;
+    }
+}
+
+bool Crc8Wrapper::calculateFrameAndPush(const DataFrameView& inFrame,
+                                        const CalculateFrameParams& prms)
+{
+    try
+    {
+        const auto state = takeState(0);
+        auto outFrame = calculateOutputFrame(
+            inFrame, checksumInfo(prms.checksum), prms.outputBudget, prms.segmentsPool, *state);
+        return prms.dest.waitAndPush(std::move(outFrame));
+    }
+    catch (...)
+    {
+        prms.dest.close();
+        throw;
+    }
+}
+
+DataFrame Crc8Wrapper::calculateOutputFrame(const DataFrameView& inFrame,
+                                            const ChecksumInfo& checksum,
+                                            MemoryBudgetPtr outputBudget,
+                                            boost::asio::thread_pool* segmentsPool,
+                                            CalculationState& state)
+{
+    const auto chunkSize = outputFrameCapacity(inFrame, checksum.digestSize);
+    auto& poolCache = state.memoryPoolCache;
+    if (poolCache.chunkSize != chunkSize || !poolCache.memoryPool)
+        poolCache = {chunkSize, outputMemoryPool(chunkSize, std::move(outputBudget))};
+    return calculateFrame(
+        inFrame, poolCache.memoryPool, checksum, segmentsPool, state.kernelCache);
+}
+
+void Crc8Wrapper::IdleStateReturner::operator()(CalculationState* state) const
+{
+    [[maybe_unused]] const auto isPushed = idleStates->bounded_push(state);
+    assert(isPushed);
+}
+
+Crc8Wrapper::CalculationStatePtr Crc8Wrapper::takeState(size_t batchSize)
+{
+    CalculationState* state = nullptr;
+    if (!idleStates_.pop(state))
+    {
+        std::lock_guard<std::mutex> lk(statesMut_);
+        idleStates_.reserve(1);
+        state = states_.emplace_back(std::make_unique<CalculationState>()).get();
+    }
+    CalculationStatePtr result(state, {&idleStates_});
+    if (result->inFrames.size() < batchSize)
+        result->inFrames.resize(batchSize);
+    return result;
+}
+
+LazyMemoryPoolPtr Crc8Wrapper::outputMemoryPool(size_t chunkSize, MemoryBudgetPtr budget)
+{
+    std::lock_guard<std::mutex> lk(outputMemoryPoolsMut_);
+    auto& memoryPool = outputMemoryPools_[chunkSize];
+    if (!memoryPool)
+        memoryPool = std::make_shared<LazyMemoryPool>(std::move(budget));
+    return memoryPool;
+}
+
 void Crc8Wrapper::joinAndRethrowExceptions()
 {
-    for (auto& future : futures_)
-        future.get();
-    futures_.clear();
+    joinAndRethrowFirstException(futures_);
 }
 
 } // namespace Parallel
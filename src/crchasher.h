@@ -1,38 +1,177 @@
 #pragma once
 
+#include "checksum.h"
 #include "concurentqueue.h"
+#include "crc8kernels.h"
 #include "dataframe.h"
 #include "defs.h"
+#include "stagescheduler.h"
 
 #include <boost/asio/thread_pool.hpp>
+#include <boost/lockfree/stack.hpp>
 
+#include <functional>
 #include <future>
-
-using Crc8ResultType = unsigned char;
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 // NOTE: CRC-8-Dallas/Maxim
 Crc8ResultType crc8(ConstDataRange range);
+DataFrame calculateCrc8OfFrame(const DataFrameView& inFrame,
+                               Parallel::LazyMemoryPoolPtr memoryPool);
+// NOTE: The kernel must be chosen by crc8BlocksKernelFor() for the block size of the frame
+DataFrame calculateCrc8OfFrame(const DataFrameView& inFrame,
+                               Parallel::LazyMemoryPoolPtr memoryPool,
+                               Crc8BlocksKernel kernel);
+// NOTE: The output frame has one digest per input block. Neither the zero padding of the last block
+// nor the hole blocks are hashed, their digests are calculated by checksum.zeroPaddedBlockKernel.
+// The input may be any view, e.g. a slice of a shared frame or borrowed memory
+DataFrame calculateChecksumOfFrame(const DataFrameView& inFrame,
+                                   Parallel::LazyMemoryPoolPtr memoryPool,
+                                   ChecksumBlocksKernel kernel,
+                                   const ChecksumInfo& checksum);
+// NOTE: The same for a whole frame
 DataFrame calculateCrc8OfFrame(const DataFrame& inFrame, Parallel::LazyMemoryPoolPtr memoryPool);
+DataFrame calculateChecksumOfFrame(const DataFrame& inFrame,
+                                   Parallel::LazyMemoryPoolPtr memoryPool,
+                                   ChecksumBlocksKernel kernel,
+                                   const ChecksumInfo& checksum);
 
 namespace Parallel
 {
+// NOTE: Splits the range into segments which are hashed by the pool threads and merged with
+// crc8Combine(). The calling thread hashes every segment that no pool thread has taken yet, so the
+// function doesn't wait for the pool to become idle
+Crc8ResultType crc8(ConstDataRange range, size_t segmentsCount, boost::asio::thread_pool& pool);
+
 class Crc8Wrapper
 {
 public:
+    // NOTE: A task takes only the frames which are ready, so a small batch keeps the other tasks
+    // busy when the frames are few and still saves synchronisations when they are many
+    static constexpr size_t DefaultBatchSize = 4;
+
+    // NOTE: A task takes at most half of its share of the frames the budget lets in flight, so a
+    // small budget isn't held by one task while the others and the readers have nothing to do
+    static size_t batchSizeFor(size_t framesInFlight, size_t tasksCount);
+
     struct CalculateForWholeQueueParams
     {
         Queue<DataFrame>& src;
-        Queue<DataFrame>& dest;
-        const SharedAtomic<bool> hasProducerFinished;
+        MpscQueue<DataFrame>& dest;
         size_t tasksCount;
         boost::asio::thread_pool& pool;
+        ChecksumAlgorithm checksum = ChecksumAlgorithm::Crc8;
+        // NOTE: The tasks are pinned to the cpus, e.g. to the NUMA node whose frames are in src
+        std::vector<unsigned> cpus = {};
+        // NOTE: Calculation waits while the output frames in flight use the whole budget
+        MemoryBudgetPtr outputBudget = nullptr;
+        size_t batchSize = DefaultBatchSize;
+    };
+
+    struct CalculateFramesParams
+    {
+        Queue<DataFrame>& src;
+        MpscQueue<DataFrame>& dest;
+        ChecksumAlgorithm checksum = ChecksumAlgorithm::Crc8;
+        MemoryBudgetPtr outputBudget = nullptr;
+        size_t batchSize = DefaultBatchSize;
+        // NOTE: Called after every frame pushed, e.g. to wake the stage which drains dest. The
+        // step may wait for the output budget in the middle of the batch, and only that stage
+        // frees it
+        std::function<void()> onPushed = nullptr;
+        // NOTE: If it's set, the output memory of the frames is reserved before they are taken and
+        // the step returns NoWork while the budget is used up, rather than waiting for the writer
+        size_t outputFrameSize = 0;
+        // NOTE: Huge blocks are split (only for CRC8, which has crc8Combine()) into segments
+        // posted to this pool, usually the one the step runs on. Its idle threads help, and the
+        // step hashes the segments no one has taken, so no threads are added for them. The
+        // blocks aren't split if it's null
+        boost::asio::thread_pool* segmentsPool = nullptr;
+    };
+
+    struct CalculateFrameParams
+    {
+        MpscQueue<DataFrame>& dest;
+        ChecksumAlgorithm checksum = ChecksumAlgorithm::Crc8;
+        MemoryBudgetPtr outputBudget = nullptr;
+        // NOTE: The same as for CalculateFramesParams
+        boost::asio::thread_pool* segmentsPool = nullptr;
     };
 
 public:
     void calculateForWholeQueue(CalculateForWholeQueueParams params);
     void joinAndRethrowExceptions();
 
+    // NOTE: A step for a StageScheduler, hashes the batch of frames which are ready
+    StepResult calculateFrames(const CalculateFramesParams& params);
+    // NOTE: Hashes a frame the calling worker has just read while it's still in the CPU cache, or
+    // a view of a mapped file. Returns false if the consumer has failed
+    bool calculateFrameAndPush(const DataFrameView& inFrame, const CalculateFrameParams& params);
+
+private:
+    struct BlocksKernelCache
+    {
+        size_t blockSize = 0;
+        ChecksumBlocksKernel kernel = nullptr;
+    };
+
+    struct OutputMemoryPoolCache
+    {
+        size_t chunkSize = 0;
+        LazyMemoryPoolPtr memoryPool;
+    };
+
+    struct CalculationState
+    {
+        std::vector<DataFrame> inFrames;
+        BlocksKernelCache kernelCache = {};
+        OutputMemoryPoolCache memoryPoolCache = {};
+    };
+
+    struct IdleStateReturner
+    {
+        boost::lockfree::stack<CalculationState*>* idleStates = nullptr;
+        void operator()(CalculationState* state) const;
+    };
+    using CalculationStatePtr = std::unique_ptr<CalculationState, IdleStateReturner>;
+
+    // NOTE: Takes a state left by a step which has finished, so the steps don't allocate the
+    // frames vector and don't start with cold caches. The state is given back with the pointer
+    CalculationStatePtr takeState(size_t batchSize);
+
+    // NOTE: Returns false if the consumer has failed
+    bool calculateAndPush(const CalculateFramesParams& params,
+                          size_t framesCount,
+                          CalculationState& state);
+
+    DataFrame calculateOutputFrame(const DataFrameView& inFrame,
+                                   const ChecksumInfo& checksum,
+                                   MemoryBudgetPtr outputBudget,
+                                   boost::asio::thread_pool* segmentsPool,
+                                   CalculationState& state);
+
+    // NOTE: Output frames of one size share a memory pool, all the frames of a run usually have one
+    LazyMemoryPoolPtr outputMemoryPool(size_t chunkSize, MemoryBudgetPtr budget);
+
+    DataFrame calculateFrame(const DataFrameView& inFrame,
+                             LazyMemoryPoolPtr memoryPool,
+                             const ChecksumInfo& checksum,
+                             boost::asio::thread_pool* segmentsPool,
+                             BlocksKernelCache& kernelCache);
+
 private:
     std::vector<std::future<void>> futures_;
+
+    // NOTE: There are as many states as steps have run at once. They are created under the lock
+    // and every one of them reserves a node of the idle list, so giving a state back doesn't
+    // allocate
+    boost::lockfree::stack<CalculationState*> idleStates_{0};
+    std::mutex statesMut_;
+    std::vector<std::unique_ptr<CalculationState>> states_;
+
+    std::mutex outputMemoryPoolsMut_;
+    std::unordered_map<size_t, LazyMemoryPoolPtr> outputMemoryPools_;
 };
 } // namespace Parallel
@@ -2,37 +2,237 @@
 #include "utils.h"
 
 #include <filesystem>
+#include <future>
 #include <iostream>
 
 #include <boost/thread/thread.hpp>
 
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#endif
+
 namespace fs = std::filesystem;
 using iob = std::ios_base;
 
 namespace
 {
-size_t getThreadCnt()
+constexpr size_t WritersCnt = 1;
+
+size_t getThreadCnt(const Options& options)
 {
-    // NOTE: We need at least one thread per reading, calculating and writing
-    if (boost::thread::hardware_concurrency() == 0)
-        return 3;
+    if (options.threadsCount != 0)
+        return std::max(options.threadsCount, MinThreadsCount);
+
+    // NOTE: We need at least one thread per stage: reading, calculating and writing
+    const size_t coresCnt = boost::thread::hardware_concurrency();
+    if (coresCnt == 0)
+        return MinThreadsCount;
     else
-        return std::max(3u, boost::thread::hardware_concurrency() - 1);
+        return std::max(MinThreadsCount, coresCnt - 1);
 }
 
-size_t getMaxQueueSize(size_t dataBlockSize, size_t crcHasherResultSize, size_t maxRamSize)
+// NOTE: Stream buffers of the files take no more than this share of the RAM, the rest is left for
+// the frames
+constexpr size_t StreamBuffersRamShare = 16;
+
+// NOTE: Queues store frames inline, a bigger queue would take noticeable memory itself
+constexpr size_t MaxQueueCapacity = 4096;
+
+constexpr size_t StagesCnt = MinThreadsCount;
+
+// NOTE: Used when the system doesn't report the size of the L2 cache
+constexpr size_t DefaultL2CacheSize = 512 * KB;
+
+// NOTE: Smaller than the fused frames, so the stream reads them straight into their memory rather
+// than through its buffer, which would take the cache as well
+constexpr size_t FusedInputStreamBufferSize = 4 * KB;
+
+size_t getL2CacheSize()
+{
+#ifdef _SC_LEVEL2_CACHE_SIZE
+    if (const auto size = ::sysconf(_SC_LEVEL2_CACHE_SIZE); size > 0)
+        return static_cast<size_t>(size);
+#endif
+    return DefaultL2CacheSize;
+}
+
+// NOTE: In the fused mode a frame is hashed by the worker which has read it, so it should still be
+// in the L2 cache then. Half of the cache is left for the digests and the rest of the worker's data
+size_t getFusedMaxDataFrameSize()
+{
+    return getL2CacheSize() / 2;
+}
+
+// NOTE: More concurrent readers only make a hard disk seek between them
+constexpr size_t HddMaxReadersCnt = 2;
+
+// NOTE: It's a limit rather than a number of threads set aside for reading: a hard disk reads
+// faster with fewer concurrent readers. The run starts with it and the tuner looks for the best
+// number of readers from there on. In the fused mode every worker but the writer may read
+size_t getInitialReadersCnt(const Options& options)
+{
+    if (options.readersCount != 0)
+        return options.readersCount;
+    if (!options.isSSD)
+        return 1;
+    return options.isReadAndHashFused ? getThreadCnt(options) - WritersCnt
+                                      : ceilDevision(getThreadCnt(options), 4);
+}
+
+// NOTE: The frames of the direct input begin at aligned offsets of the file, so they are read
+// with O_DIRECT into the aligned memory of the frames
+size_t getFrameAlignment(const Options& options)
+{
+    return options.isInputDirect && !options.isInputMapped ? DirectIoAlignment : 1;
+}
+
+// NOTE: The mapped and the fused input are read otherwise, the command line rejects --io-depth
+// with --fused
+unsigned getIoQueueDepth(const Options& options)
+{
+    if (options.isInputMapped || options.isReadAndHashFused || !IoRingFile::isSupported())
+        return 0;
+    return static_cast<unsigned>(options.ioQueueDepth);
+}
+
+// NOTE: Every reader has its own stream buffer, the memory is planned for this many of them. The
+// tuner may let every worker read but the writer and, unless the mode is fused, one hasher, or
+// just a couple of workers of a hard disk. The mapped input has no readers, its pages are read by
+// the system, and the ring needs no buffers
+size_t getMaxReadersCnt(const Options& options)
+{
+    if (options.isInputMapped || getIoQueueDepth(options) != 0)
+        return 0;
+    if (options.readersCount != 0)
+        return options.readersCount;
+    const size_t hashersCnt = options.isReadAndHashFused ? 0 : 1;
+    const auto readersCnt = getThreadCnt(options) - WritersCnt - hashersCnt;
+    return options.isSSD ? readersCnt : std::min(readersCnt, HddMaxReadersCnt);
+}
+
+// NOTE: Every NUMA node gets the same number of workers of a stage
+size_t getCntPerNode(size_t cnt, size_t numaNodesCnt)
+{
+    return ceilDevision(cnt, std::max<size_t>(numaNodesCnt, 1));
+}
+
+std::vector<Parallel::NumaNode> getNumaNodesToUse(const Options& options)
+{
+    // NOTE: The pages of the page cache are placed regardless of the nodes of the workers. A
+    // single ring serves all the reads
+    if (!options.isNumaAware || options.isInputMapped || getIoQueueDepth(options) != 0)
+        return {};
+
+    auto nodes = Parallel::getNumaNodes();
+    if (nodes.size() < 2)
+        return {};
+
+    // NOTE: Every node has a scheduler of its own with a worker per stage. Otherwise the frames of
+    // a node may use the whole budget and never be hashed
+    if (getThreadCnt(options) / nodes.size() < StagesCnt)
+        return {};
+    return nodes;
+}
+
+Parallel::MemoryArenaPtr makeArena(size_t size,
+                                   bool isPrefaulted,
+                                   const std::vector<unsigned>& cpus)
+{
+    if (!isPrefaulted || cpus.empty())
+        return std::make_shared<Parallel::MemoryArena>(size, isPrefaulted);
+
+    // NOTE: Pages are placed on the node of the thread which touches them first
+    return std::async(std::launch::async, [&]() {
+               Parallel::ThreadPinning pinning(cpus);
+               return std::make_shared<Parallel::MemoryArena>(size, isPrefaulted);
+           })
+        .get();
+}
+
+size_t getStreamBufferSize(size_t maxRamSize, size_t filesCnt)
+{
+    return std::min(DataFile::OptimalStreamBufferSize,
+                    maxRamSize / StreamBuffersRamShare / filesCnt);
+}
+
+size_t getInputStreamBufferSize(const Options& options, size_t streamBufferSize)
+{
+    return options.isReadAndHashFused ? std::min(streamBufferSize, FusedInputStreamBufferSize)
+                                      : streamBufferSize;
+}
+
+// NOTE: The errors of a file are prefixed with its role, the same stream errors come from both
+template <typename Step>
+auto runFileStep(const std::string& fileRole, Step step)
+{
+    try
+    {
+        return step();
+    }
+    catch (std::fstream::failure& e)
+    {
+        throw std::fstream::failure(
+            "Error during working with " + fileRole + " file: " + std::string(e.what()), e.code());
+    }
+}
+
+struct FramesMemory
+{
+    size_t input = 0;
+    size_t output = 0;
+    size_t maxDataFrameSize = 0;
+    // NOTE: The number of input frames which fit into the input budget, or of the output ones for
+    // the mapped input
+    size_t framesInFlight = 0;
+};
+
+// NOTE: The RAM which isn't taken by the stream buffers and the configs of the input frames is
+// split between the input and output frames in proportion to their sizes, so both stages may have
+// the same number of frames in flight. The mapped input frames take no memory of their own, so
+// all of it is left for the output ones
+FramesMemory getFramesMemory(const Options& options, size_t readersCnt, size_t streamBuffersSize)
 {
-    // NOTE: We allocate RAM in such a way that the input and output queues have the same maximum
-    // number of elements
-    const auto maxQueueSize = (maxRamSize / (dataBlockSize + crcHasherResultSize));
-    if (maxQueueSize == 0)
+    const auto digestSize = checksumInfo(options.checksum).digestSize;
+    const auto blockAndDigestSize = options.blockSize + digestSize;
+    auto framesMemory = options.maxRamSize - std::min(streamBuffersSize, options.maxRamSize);
+
+    // NOTE: Every reader, or every read of the ring, may fill a frame while its previous one waits
+    // for calculation
+    const auto framesBeingReadCnt = std::max<size_t>(readersCnt, getIoQueueDepth(options));
+    auto maxDataFrameSize =
+        options.isInputMapped
+            ? Parallel::DataFileWrapper::UnlimitedDataFrameSize
+            : framesMemory / blockAndDigestSize * options.blockSize / (2 * framesBeingReadCnt);
+    if (options.isReadAndHashFused)
+        maxDataFrameSize = std::min(maxDataFrameSize, getFusedMaxDataFrameSize());
+    const auto inputFileSize =
+        fs::exists(options.inputFile) ? fs::file_size(options.inputFile) : uintmax_t(0);
+    const auto blocksInFrame = Parallel::DataFileWrapper::dataBlocksInFrame(
+        options.blockSize, maxDataFrameSize, getFrameAlignment(options));
+    const auto framesCnt =
+        ceilDevision(ceilDevision(inputFileSize, options.blockSize), blocksInFrame);
+    const auto configsSize = framesCnt * sizeof(DataFrameConfig);
+
+    const auto minFramesMemory = options.isInputMapped ? digestSize : blockAndDigestSize;
+    if (framesMemory < configsSize + minFramesMemory)
     {
         throw std::invalid_argument(
             "Max RAM size is too small to proceed data blocks with such a size. "
             "Please, either reduce data block size, either increase max RAM size. Please run the "
             "program with --help parametr for more information");
     }
-    return maxQueueSize;
+    framesMemory -= configsSize;
+
+    const auto output =
+        options.isInputMapped ? framesMemory : framesMemory / blockAndDigestSize * digestSize;
+    const auto input = framesMemory - output;
+    const auto framesInFlight = options.isInputMapped
+                                    ? output / (blocksInFrame * digestSize)
+                                    : input / (blocksInFrame * options.blockSize);
+    return {.input = input,
+            .output = output,
+            .maxDataFrameSize = maxDataFrameSize,
+            .framesInFlight = std::max<size_t>(framesInFlight, 1)};
 }
 
 std::ios_base::openmode getOpenModeForOutputFile(const std::string_view& path)
@@ -40,17 +240,69 @@ std::ios_base::openmode getOpenModeForOutputFile(const std::string_view& path)
     const auto inOutMode = fs::exists(path) ? (iob::in | iob::out) : iob::out;
     return iob::binary | inOutMode;
 }
+
+Parallel::PoolThreadsReservation reservePoolThreads(const boost::asio::thread_pool& pool,
+                                                    size_t poolThreadsCnt,
+                                                    const Options& options)
+{
+    auto reservation =
+        Parallel::PoolThreadsReservation::tryReserve(pool, poolThreadsCnt, getThreadCnt(options));
+    if (!reservation)
+    {
+        throw std::invalid_argument(
+            "The thread pool is too small for the job. Its steps may block the threads they run "
+            "on, so the pool needs a thread for every worker of the job besides the workers of "
+            "the other jobs run on it");
+    }
+    return std::move(*reservation);
+}
 } // namespace
 
 CrcSignatureOfFile::CrcSignatureOfFile(const Options& options)
-    : pool_(getThreadCnt())
-    , readTasksCnt_(options.isSSD ? ceilDevision(getThreadCnt(), 4) : 1)
-    , inputQueue_(getMaxQueueSize(options.blockSize, sizeof(Crc8ResultType), options.maxRamSize))
-    , inputFile_(options.inputFile, (iob::binary | iob::in))
-    , crcCaclulationTasksCnt_(ceilDevision((getThreadCnt() * 3), 4))
+    : CrcSignatureOfFile(options, nullptr, getNumaNodesToUse(options))
+{
+}
+
+CrcSignatureOfFile::CrcSignatureOfFile(const Options& options,
+                                       boost::asio::thread_pool& pool,
+                                       size_t poolThreadsCnt)
+    : CrcSignatureOfFile(options,
+                         &pool,
+                         getNumaNodesToUse(options),
+                         reservePoolThreads(pool, poolThreadsCnt, options))
+{
+}
+
+CrcSignatureOfFile::CrcSignatureOfFile(
+    const Options& options,
+    boost::asio::thread_pool* pool,
+    std::vector<Parallel::NumaNode> numaNodes,
+    std::optional<Parallel::PoolThreadsReservation> poolThreadsReservation)
+    : poolThreadsReservation_(std::move(poolThreadsReservation))
+    , threadsCnt_(getThreadCnt(options))
+    , ownPool_(pool ? nullptr : std::make_unique<boost::asio::thread_pool>(threadsCnt_))
+    , pool_(pool ? *pool : *ownPool_)
+    , numaNodes_(std::move(numaNodes))
+    , initialReadersPerNode_(getCntPerNode(getInitialReadersCnt(options), numaNodes_.size()))
+    , maxReadersPerNode_(getCntPerNode(getMaxReadersCnt(options), numaNodes_.size()))
+    , maxReadersCnt_(maxReadersPerNode_ * std::max<size_t>(numaNodes_.size(), 1))
+    , maxHashersPerNode_(options.hashersCount == 0
+                             ? Parallel::StageScheduler::UnlimitedWorkers
+                             : getCntPerNode(options.hashersCount, numaNodes_.size()))
+    , isReadersTuned_(options.readersCount == 0 && !options.isInputMapped)
+    , streamBufferSize_(getStreamBufferSize(options.maxRamSize, maxReadersCnt_ + WritersCnt))
+    , inputStreamBufferSize_(getInputStreamBufferSize(options, streamBufferSize_))
+    , inputFile_(options.inputFile,
+                 (iob::binary | iob::in),
+                 inputStreamBufferSize_,
+                 options.isInputDirect && !options.isInputMapped)
     , blockSize_(options.blockSize)
-    , outputQueue_(getMaxQueueSize(options.blockSize, sizeof(Crc8ResultType), options.maxRamSize))
-    , outputFile_(options.outputFile, getOpenModeForOutputFile(options.outputFile))
+    , checksum_(options.checksum)
+    , isReadAndHashFused_(options.isReadAndHashFused)
+    , isInputMapped_(options.isInputMapped)
+    , ioQueueDepth_(getIoQueueDepth(options))
+    , outputFile_(
+          options.outputFile, getOpenModeForOutputFile(options.outputFile), streamBufferSize_)
     , outputFileName_(options.outputFile)
     , originalSizeOfOutputFile_(fs::exists(options.outputFile)
                                     ? std::optional(fs::file_size(options.outputFile))
@@ -59,61 +311,258 @@ CrcSignatureOfFile::CrcSignatureOfFile(const Options& options)
     if (blockSize_ == 0)
         throw std::logic_error("the block size cannot be zero");
 
-    // NOTE: We need reading tasks count plus writing tasks count is less than getThreadCnt()
-    // because otherwise we will not be able to post any crc calculation tasks
-    const auto writingTasksCnt = 1;
-    assert(readTasksCnt_ + writingTasksCnt < getThreadCnt());
+    // NOTE: The steps take no more frames than fit into the budgets. The queues have room for all
+    // the frames which fit, so they don't limit the stages earlier
+    const auto framesMemory =
+        getFramesMemory(options,
+                        maxReadersCnt_,
+                        inputStreamBufferSize_ * maxReadersCnt_ + streamBufferSize_ * WritersCnt);
+    inputBudget_ = std::make_shared<Parallel::MemoryBudget>(framesMemory.input);
+    outputBudget_ = std::make_shared<Parallel::MemoryBudget>(framesMemory.output);
+    maxDataFrameSize_ = framesMemory.maxDataFrameSize;
+    const auto blocksInFrame = Parallel::DataFileWrapper::dataBlocksInFrame(
+        blockSize_, maxDataFrameSize_, getFrameAlignment(options));
+    inputFrameSize_ = blocksInFrame * blockSize_;
+    // NOTE: Unaligned frames would be read through the page cache, which --direct is there to avoid
+    if (inputFrameSize_ % getFrameAlignment(options) != 0)
+    {
+        throw std::invalid_argument(
+            "The frames of such data blocks can't be aligned to 4KB for the direct reading within "
+            "the max RAM size. Please, either use a data block size which is a multiple or a "
+            "divisor of 4KB, either increase max RAM size");
+    }
+    outputFrameSize_ = blocksInFrame * checksumInfo(checksum_).digestSize;
+
+    // NOTE: The input frames memory is split equally between the nodes
+    const auto nodesCnt = std::max<size_t>(numaNodes_.size(), 1);
+    hashingBatchSize_ = Parallel::Crc8Wrapper::batchSizeFor(
+        framesMemory.framesInFlight, std::min(maxHashersPerNode_, threadsCnt_) * nodesCnt);
+    for (size_t i = 0; i < nodesCnt && !isInputMapped_; i++)
+    {
+        const auto& cpus = numaNodes_.empty() ? std::vector<unsigned>{} : numaNodes_[i].cpus;
+        auto arena = makeArena(framesMemory.input / nodesCnt, options.isMemoryPrefaulted, cpus);
+        if (ioQueueDepth_ != 0)
+            ringArena_ = arena;
+        inputMemoryPools_.push_back(
+            std::make_shared<Parallel::LazyMemoryPool>(inputBudget_, std::move(arena)));
+        // NOTE: The fused mode passes the input frames from reading to hashing by hand
+        if (!isReadAndHashFused_)
+            inputQueues_.emplace_back(std::min(framesMemory.framesInFlight, MaxQueueCapacity));
+    }
+    outputQueue_.emplace(std::min(framesMemory.framesInFlight, MaxQueueCapacity));
 };
 
 void CrcSignatureOfFile::readCalculateAndWrite()
 {
     success_ = false;
 
-    auto isReadingFinished = makeSharedAtomic<bool>(false);
-    inputFile_.readAllAsDataFrames({.dest = inputQueue_,
-                                    .dataBlockSize = blockSize_,
-                                    .tasksCount = readTasksCnt_,
-                                    .pool = pool_});
-
-    // NOTE: We post writing tasks before calculating tasks to avoid situations when we fill whole
-    // the pull with reading and calculating tasks and the writing task doesn't execute until any of
-    // the reading or calculating tasks are finished. That situation might lead to a deadlock.
-    auto isCrcCalculationFinished = makeSharedAtomic<bool>(false);
-    outputFile_.writeAllDataFrames({.src = outputQueue_,
-                                    .hasProducerFinished = isCrcCalculationFinished,
-                                    .pool = pool_,
-                                    .writingPosShift = originalSizeOfOutputFile_.value_or(0)});
-
-    crc8Hasher_.calculateForWholeQueue({.src = inputQueue_,
-                                        .dest = outputQueue_,
-                                        .hasProducerFinished = isReadingFinished,
-                                        .tasksCount = crcCaclulationTasksCnt_,
-                                        .pool = pool_});
+    if (isInputMapped_)
+        runFileStep("input",
+                    [&]() { inputFile_.prepareMappedReading(blockSize_, maxDataFrameSize_); });
+    else if (ioQueueDepth_ != 0)
+        runFileStep("input", [&]() {
+            inputFile_.prepareRingReading(blockSize_, maxDataFrameSize_, ioQueueDepth_, ringArena_);
+        });
+    else
+        inputFile_.prepareReading(blockSize_, maxDataFrameSize_);
+    const auto nodesCnt = std::max<size_t>(numaNodes_.size(), 1);
+    // NOTE: The writer runs on the first scheduler, the hashers of every node feed it
+    const auto wakeWriter = [this]() { schedulers_.front().notify(); };
+    auto calculatingNodesCnt = makeSharedAtomic<size_t>(nodesCnt);
+    const auto onNodeFinished = [this, calculatingNodesCnt, wakeWriter]() {
+        if (--*calculatingNodesCnt == 0)
+        {
+            outputQueue_->close();
+            wakeWriter();
+        }
+    };
+    for (size_t i = 0; i < nodesCnt; i++)
+    {
+        // NOTE: Every node has its own workers pinned to its cpus, they read and hash the frames
+        // placed in the memory of the node. The last node to finish hashing ends the output
+        auto& scheduler = numaNodes_.empty()
+                              ? schedulers_.emplace_back(threadsCnt_)
+                              : schedulers_.emplace_back(threadsCnt_ / nodesCnt,
+                                                         numaNodes_[i].cpus);
+        // NOTE: The mapped input is hashed by every worker but the writer
+        if (isInputMapped_)
+        {
+            scheduler.addStage(
+                {.step = [this, i]() { return notifyOtherNodes(i, mapAndCalculateFrame()); },
+                 .maxWorkers = maxHashersPerNode_,
+                 .onFinished = onNodeFinished});
+            continue;
+        }
 
+        // NOTE: A single worker keeps all the reads of the ring in flight
+        if (ioQueueDepth_ != 0)
+        {
+            scheduler.addStage({.step = [this, i]() {
+                                    return runFileStep("input", [&]() {
+                                        return inputFile_.readDataFramesWithRing(
+                                            inputQueues_[i], inputMemoryPools_[i], inputBudget_);
+                                    });
+                                },
+                                .maxWorkers = 1,
+                                .onFinished = [this, i]() { inputQueues_[i].close(); }});
+        }
+        else
+        {
+            auto& tuner = readersTuners_.emplace_back(
+                Parallel::ConcurrencyTuner::Params{.maxConcurrency = maxReadersPerNode_,
+                                                   .initialConcurrency = initialReadersPerNode_});
+            if (isReadAndHashFused_)
+            {
+                readingStageIdx_ = scheduler.addStage(
+                    {.step = [this, i]() { return notifyOtherNodes(i, readAndCalculateFrame(i)); },
+                     .maxWorkers = tuner.concurrency(),
+                     .onFinished = onNodeFinished});
+                continue;
+            }
+
+            readingStageIdx_ = scheduler.addStage(
+                {.step = [this, i]() {
+                     const auto reservation = inputBudget_->tryReserve(inputFrameSize_);
+                     if (!reservation)
+                         return Parallel::StepResult::NoWork;
+                     const auto result = runFileStep("input", [&]() {
+                         return inputFile_.readDataFrame(inputQueues_[i], inputMemoryPools_[i]);
+                     });
+                     if (result == Parallel::StepResult::Progress)
+                         tuneReaders(i, *inputBudget_);
+                     return result;
+                 },
+                 .maxWorkers = tuner.concurrency(),
+                 .onFinished = [this, i]() { inputQueues_[i].close(); }});
+        }
+        scheduler.addStage(
+            {.step = [this, i, wakeWriter]() {
+                 return notifyOtherNodes(
+                     i,
+                     crc8Hasher_.calculateFrames({.src = inputQueues_[i],
+                                                  .dest = *outputQueue_,
+                                                  .checksum = checksum_,
+                                                  .outputBudget = outputBudget_,
+                                                  .batchSize = hashingBatchSize_,
+                                                  .onPushed = wakeWriter,
+                                                  .outputFrameSize = outputFrameSize_,
+                                                  .segmentsPool = &pool_}));
+             },
+             .maxWorkers = maxHashersPerNode_,
+             .onFinished = onNodeFinished,
+             .onAbort = [this, i]() { inputQueues_[i].abort(); }});
+    }
+    schedulers_.front().addStage(
+        {.step = [this]() {
+             return notifyOtherNodes(0, runFileStep("output", [&]() {
+                                         return outputFile_.writeDataFrames(
+                                             *outputQueue_, originalSizeOfOutputFile_.value_or(0));
+                                     }));
+         },
+         .maxWorkers = WritersCnt,
+         .onAbort = [this]() { outputQueue_->abort(); }});
+
+    for (auto& scheduler : schedulers_)
+        scheduler.run(pool_);
     try
     {
-        inputFile_.joinAndRethrowExceptions();
+        for (auto& scheduler : schedulers_)
+            scheduler.joinAndRethrowExceptions();
     }
-    catch (std::fstream::failure& e)
+    catch (...)
     {
-        throw std::fstream::failure(
-            "Error during working with input file: " + std::string(e.what()), e.code());
+        stopAllStages();
+        throw;
     }
-    isReadingFinished->store(true);
+    success_ = true;
+}
 
-    crc8Hasher_.joinAndRethrowExceptions();
-    isCrcCalculationFinished->store(true);
+Parallel::StepResult CrcSignatureOfFile::readAndCalculateFrame(size_t nodeIdx)
+{
+    const auto inputReservation = inputBudget_->tryReserve(inputFrameSize_);
+    if (!inputReservation)
+        return Parallel::StepResult::NoWork;
+    const auto outputReservation = outputBudget_->tryReserve(outputFrameSize_);
+    if (!outputReservation)
+        return Parallel::StepResult::NoWork;
 
-    try
+    auto frame = runFileStep(
+        "input", [&]() { return inputFile_.readNextDataFrame(inputMemoryPools_[nodeIdx]); });
+    if (!frame)
+        return Parallel::StepResult::Finished;
+
+    // NOTE: The output queue is closed when the writer has failed
+    const auto isPushed = crc8Hasher_.calculateFrameAndPush(DataFrameView(*frame),
+                                                            {.dest = *outputQueue_,
+                                                             .checksum = checksum_,
+                                                             .outputBudget = outputBudget_,
+                                                             .segmentsPool = &pool_});
+    if (!isPushed)
+        return Parallel::StepResult::Finished;
+    tuneReaders(nodeIdx, *outputBudget_);
+    return Parallel::StepResult::Progress;
+}
+
+Parallel::StepResult CrcSignatureOfFile::mapAndCalculateFrame()
+{
+    const auto outputReservation = outputBudget_->tryReserve(outputFrameSize_);
+    if (!outputReservation)
+        return Parallel::StepResult::NoWork;
+
+    const auto frame = inputFile_.mapNextDataFrame();
+    if (!frame)
+        return Parallel::StepResult::Finished;
+    const auto isPushed = crc8Hasher_.calculateFrameAndPush(*frame,
+                                                            {.dest = *outputQueue_,
+                                                             .checksum = checksum_,
+                                                             .outputBudget = outputBudget_,
+                                                             .segmentsPool = &pool_});
+    return isPushed ? Parallel::StepResult::Progress : Parallel::StepResult::Finished;
+}
+
+void CrcSignatureOfFile::tuneReaders(size_t nodeIdx, const Parallel::MemoryBudget& budgetBelow)
+{
+    if (!isReadersTuned_)
+        return;
+
+    const auto occupancy = static_cast<double>(budgetBelow.bytesInUse()) /
+                           static_cast<double>(std::max<size_t>(budgetBelow.size(), 1));
+    if (const auto readersCnt = readersTuners_[nodeIdx].onProgress(1, occupancy))
+        schedulers_[nodeIdx].setMaxWorkers(readingStageIdx_, *readersCnt);
+}
+
+Parallel::StepResult CrcSignatureOfFile::notifyOtherNodes(size_t nodeIdx,
+                                                          Parallel::StepResult result)
+{
+    if (result != Parallel::StepResult::Progress)
+        return result;
+    for (size_t i = 0; i < schedulers_.size(); i++)
     {
-        outputFile_.joinAndRethrowExceptions();
+        if (i != nodeIdx)
+            schedulers_[i].notify();
     }
-    catch (std::fstream::failure& e)
+    return result;
+}
+
+void CrcSignatureOfFile::stopAllStages() noexcept
+{
+    for (auto& inputQueue : inputQueues_)
+        inputQueue.close();
+    outputQueue_->close();
+    for (auto& scheduler : schedulers_)
+        scheduler.notify();
+
+    // NOTE: The first exception is already being thrown, the rest are consequences of it
+    for (auto& scheduler : schedulers_)
     {
-        throw std::fstream::failure(
-            "Error during working with output file: " + std::string(e.what()), e.code());
+        try
+        {
+            scheduler.joinAndRethrowExceptions();
+        }
+        catch (...)
+        {
+        }
     }
-    success_ = true;
 }
 
 void CrcSignatureOfFile::cleanup(boost::asio::thread_pool& pool,
@@ -121,6 +570,12 @@ void CrcSignatureOfFile::cleanup(boost::asio::thread_pool& pool,
                                  const std::optional<uintmax_t> originalSizeOfOutputFile)
 {
     pool.stop();
+    restoreOutputFile(outputFileName, originalSizeOfOutputFile);
+}
+
+void CrcSignatureOfFile::restoreOutputFile(const std::string_view outputFileName,
+                                           const std::optional<uintmax_t> originalSizeOfOutputFile)
+{
     if (originalSizeOfOutputFile)
         fs::resize_file(outputFileName, *originalSizeOfOutputFile);
     else
@@ -134,7 +589,11 @@ CrcSignatureOfFile::~CrcSignatureOfFile()
 
     try
     {
-        cleanup(pool_, outputFileName_, originalSizeOfOutputFile_);
+        // NOTE: A shared pool runs the workers of other jobs, it isn't stopped
+        if (ownPool_)
+            cleanup(*ownPool_, outputFileName_, originalSizeOfOutputFile_);
+        else
+            restoreOutputFile(outputFileName_, originalSizeOfOutputFile_);
     }
     catch (const fs::filesystem_error& err)
     {
@@ -1,12 +1,17 @@
 #pragma once
 
+#include "concurrencytuner.h"
 #include "concurentqueue.h"
 #include "crchasher.h"
 #include "datafilewrapper.h"
+#include "numatopology.h"
 #include "programmoptions.h"
+#include "stagescheduler.h"
 
 #include <boost/asio/thread_pool.hpp>
 
+#include <deque>
+#include <memory>
 #include <optional>
 
 namespace Test
@@ -14,6 +19,8 @@ namespace Test
 namespace CrcSignatureOfFileTestSuite
 {
 struct CleanupTest;
+struct MaxReadersOnHardDiskTest;
+struct ReadCalculateAndWriteOnSeveralSchedulersTest;
 }
 } // namespace Test
 
@@ -21,26 +28,89 @@ class CrcSignatureOfFile
 {
 public:
     explicit CrcSignatureOfFile(const Options& options);
+    // NOTE: The workers run on the shared pool, several jobs may use a pool at a time. A step may
+    // still block its thread on a full queue or on the I/O, so the threads of the pool are
+    // reserved for the workers of the job while it exists. A job which doesn't fit into the
+    // threads left by the other jobs is rejected
+    CrcSignatureOfFile(const Options& options,
+                       boost::asio::thread_pool& pool,
+                       size_t poolThreadsCnt);
     void readCalculateAndWrite();
     ~CrcSignatureOfFile();
 
 private:
+    // NOTE: The tests pass the nodes, so several schedulers are run on any system
+    CrcSignatureOfFile(
+        const Options& options,
+        boost::asio::thread_pool* pool,
+        std::vector<Parallel::NumaNode> numaNodes,
+        std::optional<Parallel::PoolThreadsReservation> poolThreadsReservation = std::nullopt);
+
+    // NOTE: Closes the queues so the stages left finish, and waits for the workers
+    void stopAllStages() noexcept;
+    // NOTE: A step of the fused mode, the worker hashes the frame it has just read
+    Parallel::StepResult readAndCalculateFrame(size_t nodeIdx);
+    // NOTE: A step of the mapped input, the worker hashes the pages of the file in place
+    Parallel::StepResult mapAndCalculateFrame();
+    // NOTE: Is called for every frame read, the readers of the node are added or removed by the
+    // throughput of the stage and by the occupancy of the budget of the stage below it
+    void tuneReaders(size_t nodeIdx, const Parallel::MemoryBudget& budgetBelow);
+    // NOTE: The budgets and the output queue are shared by the nodes, so a step which has released
+    // memory or pushed frames may have work for the parked workers of other nodes
+    Parallel::StepResult notifyOtherNodes(size_t nodeIdx, Parallel::StepResult result);
     static void cleanup(boost::asio::thread_pool& pool,
                         const std::string_view outputFileName,
                         std::optional<size_t> originalSizeOfOutputFile);
+    static void restoreOutputFile(const std::string_view outputFileName,
+                                  std::optional<size_t> originalSizeOfOutputFile);
 
 private:
-    boost::asio::thread_pool pool_;
+    // NOTE: Empty unless the job is run on a shared pool. It's released after the workers are done
+    std::optional<Parallel::PoolThreadsReservation> poolThreadsReservation_;
+    size_t threadsCnt_ = 0;
+    std::unique_ptr<boost::asio::thread_pool> ownPool_;
+    boost::asio::thread_pool& pool_;
+    // NOTE: Empty if the NUMA mode is off or useless. Otherwise every node has its own arena and
+    // input queue (none in the fused mode), which are filled and emptied only by the workers
+    // pinned to the node
+    std::vector<Parallel::NumaNode> numaNodes_;
+    std::vector<Parallel::LazyMemoryPoolPtr> inputMemoryPools_;
+    // NOTE: The memory of the input frames is registered for the reads of the ring
+    Parallel::MemoryArenaPtr ringArena_;
+    // NOTE: Workers of a node run its stages, whichever has work
+    std::deque<Parallel::StageScheduler> schedulers_;
 
-    size_t readTasksCnt_ = 0;
-    Parallel::Queue<DataFrame> inputQueue_;
+    size_t initialReadersPerNode_ = 0;
+    size_t maxReadersPerNode_ = 0;
+    size_t maxReadersCnt_ = 0;
+    size_t maxHashersPerNode_ = 0;
+    bool isReadersTuned_ = false;
+    std::deque<Parallel::ConcurrencyTuner> readersTuners_;
+    size_t readingStageIdx_ = 0;
+    size_t streamBufferSize_ = 0;
+    size_t inputStreamBufferSize_ = 0;
+    std::deque<Parallel::Queue<DataFrame>> inputQueues_;
     Parallel::DataFileWrapper inputFile_;
 
-    size_t crcCaclulationTasksCnt_ = 0;
+    // NOTE: Budgets of the bytes in flight, the input frames are at most maxDataFrameSize_ bytes
+    // so every reading task fits into the budget with a frame to spare
+    Parallel::MemoryBudgetPtr inputBudget_;
+    Parallel::MemoryBudgetPtr outputBudget_;
+    size_t maxDataFrameSize_ = 0;
+    // NOTE: The steps reserve the memory of a frame before taking one, so they never wait for it
+    size_t inputFrameSize_ = 0;
+    size_t outputFrameSize_ = 0;
+    size_t hashingBatchSize_ = Parallel::Crc8Wrapper::DefaultBatchSize;
+
     size_t blockSize_ = 0;
+    ChecksumAlgorithm checksum_ = ChecksumAlgorithm::Crc8;
+    bool isReadAndHashFused_ = false;
+    bool isInputMapped_ = false;
+    // NOTE: Zero unless the input is read through io_uring
+    unsigned ioQueueDepth_ = 0;
     Parallel::Crc8Wrapper crc8Hasher_;
 
-    Parallel::Queue<DataFrame> outputQueue_;
+    std::optional<Parallel::MpscQueue<DataFrame>> outputQueue_;
     Parallel::DataFileWrapper outputFile_;
     std::string outputFileName_;
     std::optional<uintmax_t> originalSizeOfOutputFile_;
@@ -48,4 +118,6 @@ private:
     bool success_ = false;
 
     friend Test::CrcSignatureOfFileTestSuite::CleanupTest;
+    friend Test::CrcSignatureOfFileTestSuite::MaxReadersOnHardDiskTest;
+    friend Test::CrcSignatureOfFileTestSuite::ReadCalculateAndWriteOnSeveralSchedulersTest;
 };
@@ -1,29 +1,149 @@
 #include "datafile.h"
-#include "memorysizeliterals.h"
+#include "defs.h"
 #include "utils.h"
 
-namespace
-{
-constexpr auto OptimalFstreamBufSize = MB;
-} // namespace
+#include <algorithm>
+#include <cerrno>
+#include <system_error>
+
+#if __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+#define SPARSE_FILES_SUPPORTED
+#endif
+#ifdef O_DIRECT
+#define DIRECT_IO_SUPPORTED
+#endif
+#endif
 
-DataFile::DataFile(const std::string& path, std::ios_base::openmode mode)
-    : fileStreamBuf_(OptimalFstreamBufSize)
+DataFile::DataFile(const std::string& path,
+                   std::ios_base::openmode mode,
+                   size_t streamBufferSize,
+                   bool isDirect)
+    : fileStreamBuf_(streamBufferSize)
 {
     fileStream_.rdbuf()->pubsetbuf(fileStreamBuf_.data(), fileStreamBuf_.size());
     fileStream_.exceptions(std::ifstream::failbit | std::ifstream::badbit);
     fileStream_.open(path, mode);
+
+    // NOTE: The direct descriptor is opened first, so nothing is left to close if it fails
+    if (isDirect && (mode & std::ios_base::in))
+    {
+#ifdef DIRECT_IO_SUPPORTED
+        directFd_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+        const auto error = errno;
+#else
+        const auto error = ENOTSUP;
+#endif
+        if (directFd_ == -1)
+        {
+            throw std::ifstream::failure("can't open the file " + path + " for direct reading",
+                                         std::error_code(error, std::generic_category()));
+        }
+    }
+#ifdef SPARSE_FILES_SUPPORTED
+    // NOTE: Only inputs are queried, an output which is also opened for reading is just written
+    if ((mode & std::ios_base::in) && !(mode & std::ios_base::out))
+        holesQueryFd_ = ::open(path.c_str(), O_RDONLY);
+#endif
+}
+
+bool DataFile::canBeReadDirectly(const std::string& path)
+{
+#ifdef DIRECT_IO_SUPPORTED
+    const auto fd = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+    if (fd == -1)
+        return false;
+    ::close(fd);
+    return true;
+#else
+    static_cast<void>(path);
+    return false;
+#endif
 }
 
 DataFrame DataFile::readDataBlocksAsFrame(DataFrameConfig config)
 {
+    // NOTE: Only the bytes which aren't read are zero-filled
+    config.isZeroFilled = false;
     DataFrame frame{std::move(config)};
-    fileStream_.seekg(frame.firstBlockIndex() * frame.blockSize());
+    const uintmax_t frameBegin = frame.firstBlockIndex() * frame.blockSize();
+    const uintmax_t frameEnd = frameBegin + frame.totalSizeOfAllBlocks();
+
+    // NOTE: A frame without holes is read at once. The data of the last frame ends with the file,
+    // which isn't a hole
+    const auto dataExtents = findDataExtents(holesQueryFd_, frameBegin, frameEnd);
+    if (dataExtents.size() == 1 && dataExtents.front().begin == frameBegin &&
+        (dataExtents.front().end == frameEnd || dataExtents.front().end == fileSize()))
+    {
+        const size_t readed = readBytes(frame.data(), frameBegin, frame.totalSizeOfAllBlocks());
+        if (readed != frame.totalSizeOfAllBlocks())
+        {
+            frame.setBlocksCount(ceilDevision(readed, frame.blockSize()));
+            frame.setPaddingSize(frame.totalSizeOfAllBlocks() - readed);
+            std::fill(frame.begin() + readed, frame.end(), 0);
+        }
+        return frame;
+    }
+
+    // NOTE: The file may end with a hole, so its size is taken from the file system rather than
+    // from the reading result
+    const auto fileSize = this->fileSize();
+    const auto dataSize =
+        static_cast<size_t>(std::clamp(fileSize, frameBegin, frameEnd) - frameBegin);
+    frame.setBlocksCount(ceilDevision(dataSize, frame.blockSize()));
+    frame.setPaddingSize(frame.totalSizeOfAllBlocks() - dataSize);
+
+    // NOTE: Holes aren't read, they are zero-filled
+    size_t filledSize = 0;
+    for (const auto& extent : dataExtents)
+    {
+        // NOTE: A direct read of the data at the end of the file is requested up to the end of
+        // the frame, so it stays aligned
+        const auto offset = static_cast<size_t>(extent.begin - frameBegin);
+        const auto extentEnd = directFd_ != -1 && extent.end == fileSize ? frameEnd : extent.end;
+        const auto size = static_cast<size_t>(extentEnd - extent.begin);
+        std::fill(frame.begin() + filledSize, frame.begin() + offset, 0);
+        filledSize = offset + readBytes(frame.data() + offset, extent.begin, size);
+    }
+    std::fill(frame.begin() + filledSize, frame.end(), 0);
+    frame.setHoles(
+        findHoleBlocks(dataExtents, frameBegin, frame.blockSize(), frame.blocksCount()));
+    return frame;
+}
+
+uintmax_t DataFile::fileSize()
+{
+#ifdef SPARSE_FILES_SUPPORTED
+    struct stat status;
+    if (holesQueryFd_ != -1 && ::fstat(holesQueryFd_, &status) == 0)
+        return static_cast<uintmax_t>(status.st_size);
+#endif
+    fileStream_.seekg(0, std::ios_base::end);
+    return static_cast<uintmax_t>(fileStream_.tellg());
+}
+
+size_t DataFile::readBytes(char* dest, uintmax_t pos, size_t size)
+{
+    size_t directlyReaded = 0;
+    if (directFd_ != -1)
+    {
+        directlyReaded = readBytesDirectly(dest, pos, size);
+        if (directlyReaded == size || directlyReaded % DirectIoAlignment != 0)
+            return directlyReaded;
+        dest += directlyReaded;
+        pos += directlyReaded;
+        size -= directlyReaded;
+    }
+
+    fileStream_.seekg(pos);
 
     // TODO: add filereading errors handling
     try
     {
-        fileStream_.read(frame.data(), frame.totalSizeOfAllBlocks());
+        fileStream_.read(dest, size);
     }
     catch (std::ifstream::failure& e)
     {
@@ -35,15 +155,43 @@ DataFrame DataFile::readDataBlocksAsFrame(DataFrameConfig config)
         else
             throw;
     }
+    return directlyReaded + static_cast<size_t>(fileStream_.gcount());
+}
 
-    const size_t readed = fileStream_.gcount();
-    if (readed != frame.totalSizeOfAllBlocks())
-        frame.setBlocksCount(ceilDevision(readed, frame.blockSize()));
-
-    return frame;
+size_t DataFile::readBytesDirectly(char* dest, uintmax_t pos, size_t size)
+{
+#ifdef DIRECT_IO_SUPPORTED
+    size_t readed = 0;
+    while (readed < size && reinterpret_cast<uintptr_t>(dest + readed) % DirectIoAlignment == 0 &&
+           (pos + readed) % DirectIoAlignment == 0 && (size - readed) % DirectIoAlignment == 0)
+    {
+        const auto result =
+            ::pread(directFd_, dest + readed, size - readed, static_cast<off_t>(pos + readed));
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result < 0)
+            throw std::ifstream::failure("can't read the file directly",
+                                         std::error_code(errno, std::generic_category()));
+        // NOTE: The end of the file
+        if (result == 0 || static_cast<size_t>(result) % DirectIoAlignment != 0)
+            return readed + static_cast<size_t>(result);
+        readed += static_cast<size_t>(result);
+    }
+    return readed;
+#else
+    static_cast<void>(dest);
+    static_cast<void>(pos);
+    static_cast<void>(size);
+    return 0;
+#endif
 }
 
 void DataFile::writeDataFrame(const DataFrame& frame, const uintmax_t writingPosShift)
+{
+    writeDataFrame(DataFrameView(frame), writingPosShift);
+}
+
+void DataFile::writeDataFrame(const DataFrameView& frame, const uintmax_t writingPosShift)
 {
     fileStream_.seekp(writingPosShift + frame.firstBlockIndex() * frame.blockSize());
     fileStream_.write(frame.data(), frame.totalSizeOfAllBlocks());
@@ -51,5 +199,13 @@ void DataFile::writeDataFrame(const DataFrame& frame, const uintmax_t writingPos
 
 DataFile::~DataFile()
 {
+#ifdef SPARSE_FILES_SUPPORTED
+    if (holesQueryFd_ != -1)
+        ::close(holesQueryFd_);
+#endif
+#ifdef DIRECT_IO_SUPPORTED
+    if (directFd_ != -1)
+        ::close(directFd_);
+#endif
     fileStream_.close();
 }
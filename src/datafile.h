@@ -1,18 +1,43 @@
 #pragma once
 
 #include "dataframe.h"
+#include "memorysizeliterals.h"
+#include "sparsefile.h"
 
 #include <fstream>
 
 class DataFile
 {
 public:
-    DataFile(const std::string& path, std::ios_base::openmode mode);
+    static constexpr size_t OptimalStreamBufferSize = MB;
+
+    // NOTE: The direct file is read with O_DIRECT where the memory, the position and the size of a
+    // read are aligned to DirectIoAlignment, the other reads go through the stream. Throws if the
+    // file can't be opened with O_DIRECT, e.g. the file system doesn't support it
+    DataFile(const std::string& path,
+             std::ios_base::openmode mode,
+             size_t streamBufferSize = OptimalStreamBufferSize,
+             bool isDirect = false);
+    static bool canBeReadDirectly(const std::string& path);
     DataFrame readDataBlocksAsFrame(DataFrameConfig config);
-    void writeDataFrame(const DataFrame& data, uintmax_t writingPosShift = 0);
+    void writeDataFrame(const DataFrame& frame, uintmax_t writingPosShift = 0);
+    void writeDataFrame(const DataFrameView& frame, uintmax_t writingPosShift = 0);
     ~DataFile();
 
+private:
+    // NOTE: The current size, the file may end with a hole which isn't read
+    uintmax_t fileSize();
+    size_t readBytes(char* dest, uintmax_t pos, size_t size);
+    // NOTE: Reads while the reads stay aligned, a short read in the middle of the file may leave an
+    // unaligned rest to the stream
+    size_t readBytesDirectly(char* dest, uintmax_t pos, size_t size);
+
 private:
     std::fstream fileStream_;
     std::vector<char> fileStreamBuf_;
+    // NOTE: A separate descriptor to query holes with lseek(SEEK_DATA/SEEK_HOLE), since fstream
+    // doesn't expose its own one. It's opened only for inputs, -1 if holes can't be queried
+    int holesQueryFd_ = -1;
+    // NOTE: -1 unless the file is read directly
+    int directFd_ = -1;
 };
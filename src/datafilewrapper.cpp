@@ -1,11 +1,13 @@
 #include "datafilewrapper.h"
 #include "memorysizeliterals.h"
+#include "numatopology.h"
 #include "utils.h"
 
 #include <boost/asio/post.hpp>
 #include <boost/pool/pool_alloc.hpp>
 
 #include <filesystem>
+#include <numeric>
 
 namespace Parallel
 {
@@ -14,21 +16,49 @@ namespace
 constexpr size_t OptimalDataFrameSize = MB;
 } // namespace
 
-DataFileWrapper::DataFileWrapper(const std::string& path, const std::ios_base::openmode mode)
+DataFileWrapper::DataFileWrapper(const std::string& path,
+                                 const std::ios_base::openmode mode,
+                                 const size_t streamBufferSize,
+                                 const bool isDirect)
     : path_(path)
-    , mode_(mode){};
+    , mode_(mode)
+    , streamBufferSize_(streamBufferSize)
+    , isDirect_(isDirect){};
+
+size_t DataFileWrapper::dataBlocksInFrame(const size_t dataBlockSize,
+                                          const size_t maxDataFrameSize,
+                                          const size_t alignment)
+{
+    assert(dataBlockSize != 0 && alignment != 0);
+    const auto optimalDataBlocksInFrame = ceilDevision(OptimalDataFrameSize, dataBlockSize);
+    const auto blocksInFrame = optimalDataBlocksInFrame <= maxDataFrameSize / dataBlockSize
+                                   ? optimalDataBlocksInFrame
+                                   : std::max<size_t>(maxDataFrameSize / dataBlockSize, 1);
+
+    // NOTE: The size of an aligned frame is a multiple of the alignment, so is the offset of every
+    // frame in the file
+    const auto alignedBlocksMultiple = alignment / std::gcd(dataBlockSize, alignment);
+    if (blocksInFrame >= alignedBlocksMultiple)
+        return blocksInFrame / alignedBlocksMultiple * alignedBlocksMultiple;
+    if (alignedBlocksMultiple <= maxDataFrameSize / dataBlockSize)
+        return alignedBlocksMultiple;
+    return blocksInFrame;
+}
 
 DataFrameConfigsPtr DataFileWrapper::makeConfigs(const uintmax_t fileSize,
                                                  const size_t dataBlockSize,
-                                                 LazyMemoryPoolPtr memoryPool)
+                                                 LazyMemoryPoolPtr memoryPool,
+                                                 const size_t maxDataFrameSize,
+                                                 const size_t alignment)
 {
     assert(dataBlockSize != 0);
     if (fileSize == 0)
         return std::make_shared<DataFrameConfigs>();
 
     const size_t dataBlocksInFile = ceilDevision(fileSize, dataBlockSize);
-    size_t dataBlocksInFrame = ceilDevision(OptimalDataFrameSize, dataBlockSize);
-    dataBlocksInFrame = std::min(dataBlocksInFrame, dataBlocksInFile);
+    const auto dataBlocksInFrame = std::min(
+        DataFileWrapper::dataBlocksInFrame(dataBlockSize, maxDataFrameSize, alignment),
+        dataBlocksInFile);
     const auto dataFramesInFile = ceilDevision(dataBlocksInFile, dataBlocksInFrame);
 
     auto result = std::make_shared<DataFrameConfigs>();
@@ -45,55 +75,358 @@ DataFrameConfigsPtr DataFileWrapper::makeConfigs(const uintmax_t fileSize,
 
 void DataFileWrapper::readAllAsDataFrames(ReadAllAsDataFramesParams prms)
 {
-    assert(futures_.size() == 0 && prms.tasksCount != 0);
+    readAllAsDataFramesOnNodes(
+        {NodeReadingParams{.dest = prms.dest, .tasksCount = prms.tasksCount, .arena = prms.arena}},
+        prms.dataBlockSize,
+        prms.pool,
+        prms.budget,
+        prms.maxDataFrameSize);
+}
+
+void DataFileWrapper::readAllAsDataFramesOnNodes(const std::vector<NodeReadingParams>& nodes,
+                                                 const size_t dataBlockSize,
+                                                 boost::asio::thread_pool& pool,
+                                                 MemoryBudgetPtr budget,
+                                                 const size_t maxDataFrameSize)
+{
+    assert(futures_.size() == 0 && !nodes.empty());
+
+    prepareReading(dataBlockSize, maxDataFrameSize);
+    for (const auto& node : nodes)
+    {
+        assert(node.tasksCount != 0);
+        const auto memoryPool = std::make_shared<LazyMemoryPool>(budget, node.arena);
+        for (size_t i = 0; i < node.tasksCount; i++)
+        {
+            std::packaged_task<void()> task([=, &dest = node.dest, cpus = node.cpus]() {
+                ThreadPinning pinning(cpus);
+                while (readDataFrame(dest, memoryPool) == StepResult::Progress)
+                    ;
+            });
+            futures_.push_back(task.get_future());
+            post(pool, std::move(task));
+        }
+    }
+}
+
+size_t DataFileWrapper::frameAlignment() const noexcept
+{
+    return isDirect_ ? DirectIoAlignment : 1;
+}
+
+void DataFileWrapper::prepareReading(const size_t dataBlockSize, const size_t maxDataFrameSize)
+{
+    configs_ = makeConfigs(std::filesystem::file_size(path_),
+                           dataBlockSize,
+                           nullptr,
+                           maxDataFrameSize,
+                           frameAlignment());
+    nextConfigIdx_.store(0);
+}
+
+StepResult DataFileWrapper::readDataFrame(Queue<DataFrame>& dest, LazyMemoryPoolPtr memoryPool)
+{
+    try
+    {
+        auto frame = readNextDataFrame(std::move(memoryPool));
+        if (!frame)
+            return StepResult::Finished;
+        // NOTE: The queue is closed when the consumers have failed
+        return dest.waitAndPush(std::move(*frame)) ? StepResult::Progress : StepResult::Finished;
+    }
+    catch (...)
+    {
+        // NOTE: The consumers drain the frames read so far and stop
+        dest.close();
+        throw;
+    }
+}
+
+std::optional<DataFrame> DataFileWrapper::readNextDataFrame(LazyMemoryPoolPtr memoryPool)
+{
+    assert(configs_);
+    const auto configIdx = nextConfigIdx_++;
+    if (configIdx >= configs_->size())
+    {
+        closeIdleFiles();
+        return std::nullopt;
+    }
+
+    auto config = std::move(configs_->at(configIdx));
+    config.memoryPool = std::move(memoryPool);
+    auto file = takeIdleFile();
+    auto frame = file->readDataBlocksAsFrame(std::move(config));
+    putIdleFile(std::move(file));
+    return frame;
+}
+
+void DataFileWrapper::prepareMappedReading(const size_t dataBlockSize,
+                                           const size_t maxDataFrameSize)
+{
+    mappedFile_ = std::make_unique<MappedFile>(path_);
+    configs_ = makeConfigs(mappedFile_->size(), dataBlockSize, nullptr, maxDataFrameSize);
+    nextConfigIdx_.store(0);
+}
+
+std::optional<DataFrameView> DataFileWrapper::mapNextDataFrame()
+{
+    assert(configs_ && mappedFile_);
+    const auto configIdx = nextConfigIdx_++;
+    if (configIdx >= configs_->size())
+        return std::nullopt;
 
-    const auto configs = makeConfigs(
-        std::filesystem::file_size(path_), prms.dataBlockSize, std::make_shared<LazyMemoryPool>());
-    auto currentConfigIndex = makeSharedAtomic<size_t>(0);
+    const auto& config = configs_->at(configIdx);
+    const auto fileSize = mappedFile_->size();
+    const uintmax_t frameBegin = config.firstBlockIdx * config.blockSize;
+    const auto blocksCount =
+        std::min(config.blocksCount, ceilDevision(fileSize - frameBegin, config.blockSize));
+    const uintmax_t frameSize = blocksCount * config.blockSize;
+    const auto dataEnd = std::min(frameBegin + frameSize, fileSize);
+    mappedFile_->throwIfTruncated(dataEnd);
+    mappedFile_->adviseWillNeed(frameBegin + frameSize, frameSize);
 
-    for (size_t i = 0; i < prms.tasksCount; i++)
+    // NOTE: The tail of the last block lies past the end of the mapping, hashing doesn't touch the
+    // padding
+    DataFrameView frame(mappedFile_->data() + frameBegin,
+                        config.firstBlockIdx,
+                        config.blockSize,
+                        blocksCount);
+    if (frameBegin + frameSize > fileSize)
+        frame.setPaddingSize(static_cast<size_t>(frameBegin + frameSize - fileSize));
+    // NOTE: The pages of holes aren't touched either, their digests are known without hashing
+    frame.setHoles(findHoleBlocks(mappedFile_->findDataExtents(frameBegin, dataEnd),
+                                  frameBegin,
+                                  config.blockSize,
+                                  blocksCount));
+    return frame;
+}
+
+void DataFileWrapper::prepareRingReading(const size_t dataBlockSize,
+                                         const size_t maxDataFrameSize,
+                                         const unsigned queueDepth,
+                                         MemoryArenaPtr arena)
+{
+    ringFile_ = std::make_unique<IoRingFile>(path_, queueDepth, isDirect_);
+    if (arena)
+        ringFile_->registerBuffer(arena->data(), arena->size());
+    configs_ = makeConfigs(
+        ringFile_->size(), dataBlockSize, nullptr, maxDataFrameSize, frameAlignment());
+    nextConfigIdx_.store(0);
+    ringReads_.assign(queueDepth, RingRead());
+    freeRingReads_.clear();
+    for (size_t i = 0; i < queueDepth; i++)
+        freeRingReads_.push_back(queueDepth - i - 1);
+}
+
+StepResult DataFileWrapper::readDataFramesWithRing(Queue<DataFrame>& dest,
+                                                   LazyMemoryPoolPtr memoryPool,
+                                                   MemoryBudgetPtr budget)
+{
+    assert(configs_ && ringFile_);
+    try
     {
-        std::packaged_task<void()> task([=]() {
-            DataFile file(path_, mode_);
-            while (true)
+        queueRingReads(memoryPool, budget.get());
+        if (ringFile_->inFlightCount() == 0)
+        {
+            // NOTE: The budget is used up by the frames read earlier
+            if (nextConfigIdx_ < configs_->size())
+                return StepResult::NoWork;
+            ringFile_.reset();
+            return StepResult::Finished;
+        }
+
+        ringCompletions_.clear();
+        ringFile_->reap(ringCompletions_, 1);
+        for (const auto& completion : ringCompletions_)
+        {
+            auto& read = ringReads_[completion.userData];
+            if (completion.result < 0)
             {
-                size_t configIdx = (*currentConfigIndex)++;
-                if (configIdx >= configs->size())
-                    break;
-                auto frame = file.readDataBlocksAsFrame(std::move(configs->at(configIdx)));
-                prms.dest.waitAndPush(std::move(frame));
+                throw std::fstream::failure(
+                    "can't read the file " + path_,
+                    std::error_code(-completion.result, std::generic_category()));
             }
-        });
-        futures_.push_back(task.get_future());
-        post(prms.pool, std::move(task));
+
+            // NOTE: A short read is continued, an empty one means that the file has been cut
+            const auto readSize = static_cast<size_t>(completion.result);
+            read.readSize += readSize;
+            if (read.readSize < read.dataSize)
+            {
+                if (readSize == 0)
+                {
+                    throw std::fstream::failure("the file " + path_ +
+                                                " has been truncated while being read");
+                }
+
+                const uintmax_t frameBegin = read.frame.firstBlockIndex() * read.frame.blockSize();
+                [[maybe_unused]] const auto isQueued =
+                    ringFile_->prepareRead(read.frame.data() + read.readSize,
+                                           read.dataSize - read.readSize,
+                                           frameBegin + read.readSize,
+                                           completion.userData);
+                assert(isQueued);
+                continue;
+            }
+
+            auto frame = std::move(read.frame);
+            if (read.readSize != frame.totalSizeOfAllBlocks())
+            {
+                frame.setBlocksCount(ceilDevision(read.readSize, frame.blockSize()));
+                frame.setPaddingSize(frame.totalSizeOfAllBlocks() - read.readSize);
+                std::fill(frame.begin() + read.readSize, frame.end(), 0);
+            }
+            freeRingReads_.push_back(completion.userData);
+            // NOTE: The queue is closed when the consumers have failed
+            if (!dest.waitAndPush(std::move(frame)))
+                return StepResult::Finished;
+        }
+        ringFile_->submit();
+        return StepResult::Progress;
+    }
+    catch (...)
+    {
+        dest.close();
+        throw;
     }
 }
 
+void DataFileWrapper::queueRingReads(const LazyMemoryPoolPtr& memoryPool, MemoryBudget* budget)
+{
+    while (!freeRingReads_.empty() && nextConfigIdx_ < configs_->size())
+    {
+        auto config = configs_->at(nextConfigIdx_);
+        const auto reservation =
+            budget ? budget->tryReserve(config.blocksCount * config.blockSize) : std::nullopt;
+        if (budget && !reservation)
+            break;
+
+        // NOTE: Only the bytes which aren't read are zero-filled
+        config.memoryPool = memoryPool;
+        config.isZeroFilled = false;
+        const auto readIdx = freeRingReads_.back();
+        auto& read = ringReads_[readIdx];
+        read.frame = DataFrame(std::move(config));
+        const uintmax_t frameBegin = read.frame.firstBlockIndex() * read.frame.blockSize();
+        read.dataSize = static_cast<size_t>(std::min<uintmax_t>(
+            read.frame.totalSizeOfAllBlocks(), ringFile_->size() - frameBegin));
+        read.readSize = 0;
+        // NOTE: A direct read requests the whole frame, so a read of the tail of the file stays
+        // aligned. It ends at the end of the file anyway
+        const auto readSize = isDirect_ ? read.frame.totalSizeOfAllBlocks() : read.dataSize;
+        [[maybe_unused]] const auto isQueued =
+            ringFile_->prepareRead(read.frame.data(), readSize, frameBegin, readIdx);
+        assert(isQueued);
+        freeRingReads_.pop_back();
+        nextConfigIdx_++;
+    }
+    ringFile_->submit();
+}
+
 void DataFileWrapper::writeAllDataFrames(WriteAllDataFramesParams prms)
 {
-    assert(futures_.size() == 0);
+    assert(futures_.size() == 0 && prms.batchSize != 0);
 
     std::packaged_task<void()> writingTask([&, prms]() {
-        DataFile file(path_, mode_);
-
-        DataFrame frame;
-        while (!prms.hasProducerFinished->load())
+        try
+        {
+            auto file = takeIdleFile();
+            std::vector<DataFrame> frames(prms.batchSize);
+            size_t framesCount = 0;
+            while ((framesCount = prms.src.waitAndPopBulk(frames.begin(), prms.batchSize)) != 0)
+                writeFrames(*file, frames, framesCount, prms.writingPosShift);
+        }
+        catch (...)
         {
-            while (prms.src.waitAndPop(frame, std::chrono::milliseconds(100)))
-                file.writeDataFrame(frame, prms.writingPosShift);
+            // NOTE: The producers stop pushing and the frames they wait the budget for are freed
+            prms.src.abort();
+            throw;
         }
-        while (prms.src.tryPop(frame))
-            file.writeDataFrame(frame, prms.writingPosShift);
     });
     futures_.push_back(writingTask.get_future());
     post(prms.pool, std::move(writingTask));
 }
 
+StepResult DataFileWrapper::writeDataFrames(MpscQueue<DataFrame>& src,
+                                            const uintmax_t writingPosShift,
+                                            const size_t batchSize)
+{
+    assert(batchSize != 0);
+    try
+    {
+        std::vector<DataFrame> frames(batchSize);
+        auto framesCount = src.tryPopBulk(frames.begin(), batchSize);
+        if (framesCount == 0)
+        {
+            // NOTE: The frames are pushed before the queue is closed, so none is left behind
+            if (!src.isClosed())
+                return StepResult::NoWork;
+            framesCount = src.tryPopBulk(frames.begin(), batchSize);
+            if (framesCount == 0)
+            {
+                // NOTE: The written data is flushed to the file before the stage is over
+                closeIdleFiles();
+                return StepResult::Finished;
+            }
+        }
+
+        auto file = takeIdleFile();
+        writeFrames(*file, frames, framesCount, writingPosShift);
+        putIdleFile(std::move(file));
+        return StepResult::Progress;
+    }
+    catch (...)
+    {
+        src.abort();
+        throw;
+    }
+}
+
+void DataFileWrapper::writeFrames(DataFile& file,
+                                  std::vector<DataFrame>& frames,
+                                  size_t framesCount,
+                                  uintmax_t writingPosShift)
+{
+    // NOTE: Every frame is released right after writing, so its bytes aren't charged to the budget
+    // while the rest of the batch is written
+    for (size_t i = 0; i < framesCount; i++)
+    {
+        file.writeDataFrame(frames[i], writingPosShift);
+        frames[i] = DataFrame();
+    }
+}
+
+std::unique_ptr<DataFile> DataFileWrapper::takeIdleFile()
+{
+    {
+        std::lock_guard<std::mutex> lk(idleFilesMut_);
+        if (!idleFiles_.empty())
+        {
+            auto file = std::move(idleFiles_.back());
+            idleFiles_.pop_back();
+            return file;
+        }
+    }
+    return std::make_unique<DataFile>(path_, mode_, streamBufferSize_, isDirect_);
+}
+
+void DataFileWrapper::putIdleFile(std::unique_ptr<DataFile> file)
+{
+    std::lock_guard<std::mutex> lk(idleFilesMut_);
+    idleFiles_.push_back(std::move(file));
+}
+
+void DataFileWrapper::closeIdleFiles()
+{
+    std::vector<std::unique_ptr<DataFile>> files;
+    {
+        std::lock_guard<std::mutex> lk(idleFilesMut_);
+        files.swap(idleFiles_);
+    }
+}
+
 void DataFileWrapper::joinAndRethrowExceptions()
 {
-    for (auto& future : futures_)
-        future.get();
-    futures_.clear();
+    joinAndRethrowFirstException(futures_);
 }
 
 } // namespace Parallel
@@ -3,10 +3,18 @@
 #include "concurentmemorypool.h"
 #include "concurentqueue.h"
 #include "datafile.h"
+#include "ioringfile.h"
+#include "mappedfile.h"
+#include "stagescheduler.h"
 
 #include <boost/asio/thread_pool.hpp>
 
+#include <atomic>
 #include <future>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <optional>
 
 namespace Test
 {
@@ -23,38 +31,144 @@ namespace Parallel
 class DataFileWrapper
 {
 public:
+    static constexpr size_t UnlimitedDataFrameSize = std::numeric_limits<size_t>::max();
+    // NOTE: The writer is the only consumer of its queue, so it takes all the frames ready
+    static constexpr size_t DefaultWritingBatchSize = 64;
+
     struct ReadAllAsDataFramesParams
     {
         Queue<DataFrame>& dest;
         size_t dataBlockSize;
         size_t tasksCount;
         boost::asio::thread_pool& pool;
+        // NOTE: Frames memory is taken from the arena while it has space
+        MemoryArenaPtr arena = nullptr;
+        // NOTE: Reading waits while the frames in flight use the whole budget
+        MemoryBudgetPtr budget = nullptr;
+        size_t maxDataFrameSize = UnlimitedDataFrameSize;
+    };
+
+    // NOTE: Readers of a NUMA node are pinned to its cpus and take frames memory from its own pool,
+    // so the frames are placed in the memory of the node on the first touch
+    struct NodeReadingParams
+    {
+        Queue<DataFrame>& dest;
+        size_t tasksCount;
+        MemoryArenaPtr arena = nullptr;
+        std::vector<unsigned> cpus = {};
     };
 
     struct WriteAllDataFramesParams
     {
-        Queue<DataFrame>& src;
-        SharedAtomic<bool> hasProducerFinished;
+        MpscQueue<DataFrame>& src;
         boost::asio::thread_pool& pool;
         uintmax_t writingPosShift;
+        size_t batchSize = DefaultWritingBatchSize;
     };
 
 public:
-    DataFileWrapper(const std::string& path, std::ios_base::openmode mode);
+    // NOTE: The direct input is read with O_DIRECT, bypassing the page cache. Its frames are
+    // aligned to DirectIoAlignment when the frame size limit lets, the reads which can't be aligned
+    // go through the page cache
+    DataFileWrapper(const std::string& path,
+                    std::ios_base::openmode mode,
+                    size_t streamBufferSize = DataFile::OptimalStreamBufferSize,
+                    bool isDirect = false);
 
     void readAllAsDataFrames(ReadAllAsDataFramesParams params);
+    // NOTE: Frames are distributed between the nodes dynamically, a faster node reads more of them.
+    // The budget is shared by the nodes
+    void readAllAsDataFramesOnNodes(const std::vector<NodeReadingParams>& nodes,
+                                    size_t dataBlockSize,
+                                    boost::asio::thread_pool& pool,
+                                    MemoryBudgetPtr budget = nullptr,
+                                    size_t maxDataFrameSize = UnlimitedDataFrameSize);
+
+    // NOTE: Frames hold about a megabyte of blocks, but no more than maxDataFrameSize bytes unless
+    // a single block is bigger. Frames are a multiple of the alignment in size if it fits the limit
+    static size_t dataBlocksInFrame(size_t dataBlockSize,
+                                    size_t maxDataFrameSize = UnlimitedDataFrameSize,
+                                    size_t alignment = 1);
     void writeAllDataFrames(WriteAllDataFramesParams params);
 
     void joinAndRethrowExceptions();
 
+    // NOTE: Steps for a StageScheduler, the frames are read and written by whichever workers are
+    // idle. A file stream is opened for each step running at a time and is reused by later steps
+    void prepareReading(size_t dataBlockSize, size_t maxDataFrameSize = UnlimitedDataFrameSize);
+    // NOTE: Reads the next frame of the file, the frames are taken in order by concurrent steps
+    StepResult readDataFrame(Queue<DataFrame>& dest, LazyMemoryPoolPtr memoryPool);
+    // NOTE: Returns nothing when all the frames are taken
+    std::optional<DataFrame> readNextDataFrame(LazyMemoryPoolPtr memoryPool);
+    // NOTE: The frames are views of the mapped file instead, nothing is copied. The mapping lives
+    // as long as the wrapper
+    void prepareMappedReading(size_t dataBlockSize,
+                              size_t maxDataFrameSize = UnlimitedDataFrameSize);
+    // NOTE: Returns nothing when all the frames are taken. The frame after it is requested from
+    // the system in advance
+    std::optional<DataFrameView> mapNextDataFrame();
+    // NOTE: The frames are read through io_uring with up to queueDepth reads in flight. The memory
+    // of the frames is taken from the arena if there is one, it's registered for the reads
+    void prepareRingReading(size_t dataBlockSize,
+                            size_t maxDataFrameSize,
+                            unsigned queueDepth,
+                            MemoryArenaPtr arena = nullptr);
+    // NOTE: Queues reads while the ring and the budget have room and pushes the frames completed,
+    // in any order. It waits for the reads only when no more may be queued, so a single worker
+    // keeps all of them in flight. The steps mustn't run concurrently
+    StepResult readDataFramesWithRing(Queue<DataFrame>& dest,
+                                      LazyMemoryPoolPtr memoryPool,
+                                      MemoryBudgetPtr budget = nullptr);
+    StepResult writeDataFrames(MpscQueue<DataFrame>& src,
+                               uintmax_t writingPosShift,
+                               size_t batchSize = DefaultWritingBatchSize);
+
 private:
     static DataFrameConfigsPtr makeConfigs(uintmax_t fileSize,
                                            size_t dataBlockSize,
-                                           LazyMemoryPoolPtr memoryPool);
+                                           LazyMemoryPoolPtr memoryPool,
+                                           size_t maxDataFrameSize = UnlimitedDataFrameSize,
+                                           size_t alignment = 1);
+
+    static void writeFrames(DataFile& file,
+                            std::vector<DataFrame>& frames,
+                            size_t framesCount,
+                            uintmax_t writingPosShift);
+
+    void queueRingReads(const LazyMemoryPoolPtr& memoryPool, MemoryBudget* budget);
+
+    size_t frameAlignment() const noexcept;
+
+    std::unique_ptr<DataFile> takeIdleFile();
+    void putIdleFile(std::unique_ptr<DataFile> file);
+    void closeIdleFiles();
 
 private:
     std::string path_;
     std::ios_base::openmode mode_;
+    size_t streamBufferSize_;
+    bool isDirect_;
+
+    DataFrameConfigsPtr configs_;
+    std::unique_ptr<MappedFile> mappedFile_;
+    std::atomic<size_t> nextConfigIdx_ = 0;
+
+    // NOTE: A frame being read through the ring, its index is the user data of the reads
+    struct RingRead
+    {
+        DataFrame frame;
+        // NOTE: The bytes of the file which fall into the frame and the ones read so far
+        size_t dataSize = 0;
+        size_t readSize = 0;
+    };
+    // NOTE: Declared before the ring, so the frames outlive the reads into them
+    std::vector<RingRead> ringReads_;
+    std::vector<size_t> freeRingReads_;
+    std::vector<IoRingFile::Completion> ringCompletions_;
+    std::unique_ptr<IoRingFile> ringFile_;
+
+    std::mutex idleFilesMut_;
+    std::vector<std::unique_ptr<DataFile>> idleFiles_;
 
     // NOTE: We use std::future::get() to join reading threads and get exceptions if there are some
     std::vector<std::future<void>> futures_;
@@ -1,12 +1,35 @@
 #include <assert.h>
+#include <algorithm>
 
 #include "dataframe.h"
 
+namespace
+{
+void checkPaddingSize(size_t paddingSize, size_t blocksCount, size_t blockSize)
+{
+    if (paddingSize != 0 && (blocksCount == 0 || paddingSize >= blockSize))
+        throw std::out_of_range("The padding must be shorter than the last block");
+}
+
+void checkHoles(const BlocksIntervals& holes, size_t blocksCount)
+{
+    size_t previousEnd = 0;
+    for (const auto& hole : holes)
+    {
+        if (hole.begin < previousEnd || hole.begin >= hole.end || hole.end > blocksCount)
+            throw std::out_of_range("The holes must be sorted, non-empty and lie inside the frame");
+        previousEnd = hole.end;
+    }
+}
+} // namespace
+
 DataFrame::DataFrame(DataFrameConfig config)
     : firstBlockIdx_(config.firstBlockIdx)
     , blocksCount_(config.blocksCount)
     , blockSize_(config.blockSize)
-    , data_(config.blockSize * config.blocksCount, std::move(config.memoryPool))
+    , data_(config.blockSize * config.blocksCount,
+            std::move(config.memoryPool),
+            config.isZeroFilled)
 {
     assert(blockSize_);
 }
@@ -15,9 +38,13 @@ DataFrame::DataFrame(const DataFrame& other)
     : firstBlockIdx_(other.firstBlockIdx_)
     , blocksCount_(other.blocksCount_)
     , blockSize_(other.blockSize_)
-    , data_(other.data_.capacity(), other.data_.memoryPool())
+    , paddingSize_(other.paddingSize_)
+    , holes_(other.holes_)
+    , data_(other.data_.capacity(), other.data_.memoryPool(), false)
 {
-    std::uninitialized_copy_n(other.data_.begin(), other.totalSizeOfAllBlocks(), data_.begin());
+    const auto copiedEnd =
+        std::uninitialized_copy_n(other.data_.begin(), other.totalSizeOfAllBlocks(), data_.begin());
+    std::fill(copiedEnd, data_.begin() + data_.capacity(), 0);
 }
 
 DataFrame::DataFrame(DataFrame&& other) noexcept
@@ -43,6 +70,8 @@ void DataFrame::swap(DataFrame& other) noexcept
     std::swap(firstBlockIdx_, other.firstBlockIdx_);
     std::swap(blocksCount_, other.blocksCount_);
     std::swap(blockSize_, other.blockSize_);
+    std::swap(paddingSize_, other.paddingSize_);
+    holes_.swap(other.holes_);
     data_.swap(other.data_);
 }
 
@@ -58,15 +87,15 @@ const char* DataFrame::data() const noexcept
 
 DataRange DataFrame::blockAsRange(size_t blockIndex)
 {
-    const auto begin = std::next(data_.begin(), blockIndex * blockSize_);
-    const auto end = std::next(begin, blockSize_);
+    const auto begin = std::next(data_.begin(), static_cast<ptrdiff_t>(blockIndex * blockSize_));
+    const auto end = std::next(begin, static_cast<ptrdiff_t>(blockSize_));
     return {begin, end};
 }
 
 ConstDataRange DataFrame::blockAsRange(size_t blockIndex) const
 {
-    const auto begin = std::next(data_.begin(), blockIndex * blockSize_);
-    const auto end = std::next(begin, blockSize_);
+    const auto begin = std::next(data_.begin(), static_cast<ptrdiff_t>(blockIndex * blockSize_));
+    const auto end = std::next(begin, static_cast<ptrdiff_t>(blockSize_));
     return {begin, end};
 }
 
@@ -95,6 +124,30 @@ void DataFrame::setBlocksCount(size_t blocksCount)
     if (blocksCount * blockSize_ > data_.capacity())
         throw std::out_of_range("The size of the new number of blocks is larger than the capacity");
     blocksCount_ = blocksCount;
+    paddingSize_ = 0;
+    holes_.clear();
+}
+
+size_t DataFrame::paddingSize() const noexcept
+{
+    return paddingSize_;
+}
+
+void DataFrame::setPaddingSize(size_t paddingSize)
+{
+    checkPaddingSize(paddingSize, blocksCount_, blockSize_);
+    paddingSize_ = paddingSize;
+}
+
+const BlocksIntervals& DataFrame::holes() const noexcept
+{
+    return holes_;
+}
+
+void DataFrame::setHoles(BlocksIntervals holes)
+{
+    checkHoles(holes, blocksCount_);
+    holes_ = std::move(holes);
 }
 
 size_t DataFrame::blocksCount() const noexcept
@@ -121,3 +174,141 @@ size_t DataFrame::capacity() const noexcept
 {
     return data_.capacity();
 }
+
+DataFrameView DataFrame::share() &&
+{
+    auto owner = std::make_shared<const DataFrame>(std::move(*this));
+    DataFrameView view(*owner);
+    view.owner_ = std::move(owner);
+    return view;
+}
+
+DataFrameView::DataFrameView(ConstDataIterator data,
+                             uintmax_t firstBlockIdx,
+                             size_t blockSize,
+                             size_t blocksCount)
+    : data_(data)
+    , firstBlockIdx_(firstBlockIdx)
+    , blockSize_(blockSize)
+    , blocksCount_(blocksCount)
+    , blocksCapacity_(blocksCount)
+{
+    assert(blockSize_);
+}
+
+DataFrameView::DataFrameView(const DataFrame& frame)
+    : data_(frame.cbegin())
+    , firstBlockIdx_(frame.firstBlockIndex())
+    , blockSize_(frame.blockSize())
+    , blocksCount_(frame.blocksCount())
+    , blocksCapacity_(frame.capacity() / frame.blockSize())
+    , paddingSize_(frame.paddingSize())
+{
+    // NOTE: An aliasing pointer without an owner, the frame outlives the view
+    if (!frame.holes().empty())
+        holes_ = std::shared_ptr<const BlocksIntervals>(std::shared_ptr<const BlocksIntervals>(),
+                                                        &frame.holes());
+}
+
+DataFrameView DataFrameView::slice(size_t firstBlock, size_t blocksCount) const
+{
+    if (firstBlock > blocksCount_ || blocksCount > blocksCount_ - firstBlock)
+        throw std::out_of_range("The slice must lie inside the view");
+
+    DataFrameView result(*this);
+    result.data_ = data_ + firstBlock * blockSize_;
+    result.firstBlockIdx_ = firstBlockIdx_ + firstBlock;
+    result.blocksCount_ = blocksCount;
+    result.blocksCapacity_ = blocksCount;
+    result.paddingSize_ = firstBlock + blocksCount == blocksCount_ ? paddingSize_ : 0;
+
+    result.holes_.reset();
+    if (!holes_)
+        return result;
+
+    const auto end = firstBlock + blocksCount;
+    BlocksIntervals holes;
+    for (const auto& hole : *holes_)
+    {
+        const auto begin = std::max(hole.begin, firstBlock);
+        const auto holeEnd = std::min(hole.end, end);
+        if (begin < holeEnd)
+            holes.push_back({begin - firstBlock, holeEnd - firstBlock});
+    }
+    if (!holes.empty())
+        result.holes_ = std::make_shared<const BlocksIntervals>(std::move(holes));
+    return result;
+}
+
+const char* DataFrameView::data() const noexcept
+{
+    return reinterpret_cast<const char*>(data_);
+}
+
+ConstDataRange DataFrameView::blockAsRange(size_t blockIndex) const
+{
+    const auto begin = std::next(data_, static_cast<ptrdiff_t>(blockIndex * blockSize_));
+    const auto end = std::next(begin, static_cast<ptrdiff_t>(blockSize_));
+    return {begin, end};
+}
+
+ConstDataIterator DataFrameView::cbegin() const noexcept
+{
+    return data_;
+}
+
+ConstDataIterator DataFrameView::cend() const noexcept
+{
+    return data_ + totalSizeOfAllBlocks();
+}
+
+size_t DataFrameView::blocksCount() const noexcept
+{
+    return blocksCount_;
+}
+
+size_t DataFrameView::blocksCapacity() const noexcept
+{
+    return blocksCapacity_;
+}
+
+size_t DataFrameView::paddingSize() const noexcept
+{
+    return paddingSize_;
+}
+
+void DataFrameView::setPaddingSize(size_t paddingSize)
+{
+    checkPaddingSize(paddingSize, blocksCount_, blockSize_);
+    paddingSize_ = paddingSize;
+}
+
+const BlocksIntervals& DataFrameView::holes() const noexcept
+{
+    static const BlocksIntervals NoHoles;
+    return holes_ ? *holes_ : NoHoles;
+}
+
+void DataFrameView::setHoles(BlocksIntervals holes)
+{
+    checkHoles(holes, blocksCount_);
+    if (holes.empty())
+        holes_.reset();
+    else
+        holes_ = std::make_shared<const BlocksIntervals>(std::move(holes));
+}
+
+size_t DataFrameView::blockSize() const noexcept
+{
+    return blockSize_;
+}
+
+size_t DataFrameView::totalSizeOfAllBlocks() const noexcept
+{
+    return blocksCount_ * blockSize_;
+}
+
+uintmax_t DataFrameView::firstBlockIndex() const noexcept
+{
+    return firstBlockIdx_;
+}
@@ -6,6 +6,7 @@
 #include <boost/range/sub_range.hpp>
 
 #include <memory>
+#include <vector>
 
 struct DataFrameConfig
 {
@@ -13,10 +14,23 @@ struct DataFrameConfig
     size_t blockSize = 1;
     size_t blocksCount = 0;
     Parallel::LazyMemoryPoolPtr memoryPool = nullptr;
+    // NOTE: Frames which are entirely overwritten after the creation (e.g. by reading) may skip
+    // zero-filling, it saves a full write pass over the memory
+    bool isZeroFilled = true;
 };
 using DataFrameConfigs = std::vector<DataFrameConfig>;
 using DataFrameConfigsPtr = std::shared_ptr<DataFrameConfigs>;
 
+// NOTE: Blocks [begin, end) of a frame. The indices are relative to the first block of the frame
+struct BlocksInterval
+{
+    size_t begin = 0;
+    size_t end = 0;
+};
+using BlocksIntervals = std::vector<BlocksInterval>;
+
+class DataFrameView;
+
 class DataFrame
 {
 public:
@@ -49,14 +63,88 @@ public:
     [[nodiscard]] size_t blocksCount() const noexcept;
     void setBlocksCount(size_t blocksCount);
 
+    // NOTE: When data ends in the middle of the last block, the block is complemented with zeroes.
+    // paddingSize() is the number of those zeroes, it lets hashing skip reading them. Changing the
+    // number of blocks resets it
+    [[nodiscard]] size_t paddingSize() const noexcept;
+    void setPaddingSize(size_t paddingSize);
+
+    // NOTE: Blocks which lie in holes of a sparse file. They are zero-filled and weren't read,
+    // their checksums are known without hashing. The intervals are sorted and don't overlap.
+    // Changing the number of blocks resets them
+    [[nodiscard]] const BlocksIntervals& holes() const noexcept;
+    void setHoles(BlocksIntervals holes);
+
     [[nodiscard]] size_t blockSize() const noexcept;
     [[nodiscard]] size_t totalSizeOfAllBlocks() const noexcept;
     [[nodiscard]] size_t capacity() const noexcept;
     [[nodiscard]] uintmax_t firstBlockIndex() const noexcept;
 
+    // NOTE: Moves the frame into shared ownership. The view and all its slices keep the frame
+    // alive, so parts of it can be handed to several stages without copying
+    [[nodiscard]] DataFrameView share() &&;
+
 private:
     uintmax_t firstBlockIdx_;
     size_t blocksCount_;
     size_t blockSize_;
+    size_t paddingSize_ = 0;
+    BlocksIntervals holes_;
     ZeroFilledMemory data_;
 };
+
+// NOTE: Non-owning view of the blocks of a frame. The memory may belong to a frame, to the caller,
+// be mmap'd or be a part of one big buffer. Views made by DataFrame::share() and their slices own
+// the frame together, other views borrow the memory, which must outlive them
+class DataFrameView
+{
+public:
+    DataFrameView() = default;
+    DataFrameView(ConstDataIterator data,
+                  uintmax_t firstBlockIdx,
+                  size_t blockSize,
+                  size_t blocksCount);
+    // NOTE: Borrows the frame, its memory and its holes, so the frame must outlive the view.
+    // A view of a temporary frame would dangle at once, use DataFrame::share() for that
+    explicit DataFrameView(const DataFrame& frame);
+    DataFrameView(const DataFrame&& frame) = delete;
+
+    // NOTE: Blocks [firstBlock, firstBlock + blocksCount) of the view. The padding and the holes
+    // are clipped to the slice
+    [[nodiscard]] DataFrameView slice(size_t firstBlock, size_t blocksCount) const;
+
+    [[nodiscard]] const char* data() const noexcept;
+    [[nodiscard]] ConstDataRange blockAsRange(size_t blockIndex) const;
+
+    [[nodiscard]] ConstDataIterator cbegin() const noexcept;
+    [[nodiscard]] ConstDataIterator cend() const noexcept;
+
+    [[nodiscard]] size_t blocksCount() const noexcept;
+    // NOTE: The number of blocks the memory behind the view has room for. For a view of a whole
+    // frame it follows the frame capacity
+    [[nodiscard]] size_t blocksCapacity() const noexcept;
+
+    // NOTE: The same as for DataFrame
+    [[nodiscard]] size_t paddingSize() const noexcept;
+    void setPaddingSize(size_t paddingSize);
+    [[nodiscard]] const BlocksIntervals& holes() const noexcept;
+    void setHoles(BlocksIntervals holes);
+
+    [[nodiscard]] size_t blockSize() const noexcept;
+    [[nodiscard]] size_t totalSizeOfAllBlocks() const noexcept;
+    [[nodiscard]] uintmax_t firstBlockIndex() const noexcept;
+
+private:
+    ConstDataIterator data_ = nullptr;
+    uintmax_t firstBlockIdx_ = 0;
+    size_t blockSize_ = 1;
+    size_t blocksCount_ = 0;
+    size_t blocksCapacity_ = 0;
+    size_t paddingSize_ = 0;
+    // NOTE: Copies of the view share the list, a view of a frame points to the frame's one.
+    // Null means there are no holes
+    std::shared_ptr<const BlocksIntervals> holes_;
+    std::shared_ptr<const DataFrame> owner_;
+
+    friend class DataFrame;
+};
@@ -9,5 +9,9 @@ using ConstDataIterator = const unsigned char*;
 using DataRange = boost::iterator_range<unsigned char*>;
 using ConstDataRange = boost::iterator_range<ConstDataIterator>;
 
+// NOTE: O_DIRECT reads need the memory, the file offset and the size aligned to the logical block
+// size of the device. 4KB suits the devices with 512 byte and 4KB sectors alike
+constexpr size_t DirectIoAlignment = 4096;
+
 template <typename T>
 using SharedAtomic = std::shared_ptr<std::atomic<T>>;
@@ -0,0 +1,70 @@
+#include "futex.h"
+
+#include <algorithm>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace Parallel
+{
+uint32_t Futex::load() const noexcept
+{
+    return counter_.load();
+}
+
+void Futex::wait(uint32_t expected, Clock::time_point deadline)
+{
+    waitersCount_++;
+#ifdef __linux__
+    if (deadline == Clock::time_point::max())
+    {
+        syscall(SYS_futex, &counter_, FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+    else
+    {
+        const auto now = Clock::now();
+        const auto timeout = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::max(deadline - now, Clock::duration::zero()));
+        timespec relativeTimeout{
+            .tv_sec = static_cast<time_t>(timeout.count() / 1'000'000'000),
+            .tv_nsec = static_cast<long>(timeout.count() % 1'000'000'000)};
+        syscall(SYS_futex, &counter_, FUTEX_WAIT_PRIVATE, expected, &relativeTimeout, nullptr, 0);
+    }
+#else
+    std::unique_lock<std::mutex> lk(mut_);
+    cond_.wait_until(lk, deadline, [&]() { return counter_.load() != expected; });
+#endif
+    waitersCount_--;
+}
+
+void Futex::notifyOne()
+{
+    notify(false);
+}
+
+void Futex::notifyAll()
+{
+    notify(true);
+}
+
+void Futex::notify(bool isAll)
+{
+    counter_++;
+    // NOTE: A waiter registers itself before it checks the counter, so it either sees the
+    // increment or is counted here
+    if (waitersCount_.load() == 0)
+        return;
+
+#ifdef __linux__
+    syscall(SYS_futex, &counter_, FUTEX_WAKE_PRIVATE, isAll ? INT_MAX : 1, nullptr, nullptr, 0);
+#else
+    std::lock_guard<std::mutex> lk(mut_);
+    isAll ? cond_.notify_all() : cond_.notify_one();
+#endif
+}
+} // namespace Parallel
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+
+namespace Parallel
+{
+// NOTE: A 32-bit counter which threads can wait on until it changes. On Linux waiting and waking
+// are futex system calls, elsewhere they fall back to a condition variable. Waking is skipped when
+// nobody waits, so the counter costs one atomic increment per event on the fast path
+class Futex
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    Futex() = default;
+    Futex(const Futex&) = delete;
+    Futex& operator=(const Futex&) = delete;
+
+    uint32_t load() const noexcept;
+
+    // NOTE: Waits until the counter differs from the expected value or the deadline comes. May
+    // return spuriously, so callers check their condition again
+    void wait(uint32_t expected, Clock::time_point deadline = Clock::time_point::max());
+
+    // NOTE: Increments the counter and wakes the waiters
+    void notifyOne();
+    void notifyAll();
+
+private:
+    void notify(bool isAll);
+
+private:
+    std::atomic<uint32_t> counter_ = 0;
+    std::atomic<uint32_t> waitersCount_ = 0;
+#ifndef __linux__
+    std::mutex mut_;
+    std::condition_variable cond_;
+#endif
+};
+} // namespace Parallel
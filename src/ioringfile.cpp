@@ -0,0 +1,351 @@
+#include "ioringfile.h"
+#include "defs.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <system_error>
+
+#if __has_include(<linux/io_uring.h>)
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#if defined(__NR_io_uring_setup) && defined(IORING_FEAT_RW_CUR_POS)
+#define IO_URING_AVAILABLE
+#endif
+#endif
+
+namespace
+{
+[[noreturn]] void throwRingError(const std::string& what, int error = errno)
+{
+    throw std::fstream::failure(what, std::error_code(error, std::generic_category()));
+}
+
+// NOTE: The kernel doesn't register buffers bigger than a gigabyte, a bigger one is split
+constexpr size_t MaxRegisteredBufferSize = size_t(1) << 30;
+// NOTE: The length of a read is 32 bits, bigger reads are cut
+constexpr size_t MaxReadSize = size_t(1) << 30;
+} // namespace
+
+#ifdef IO_URING_AVAILABLE
+namespace
+{
+int setupRing(unsigned entries, io_uring_params& params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int enterRing(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return static_cast<int>(
+        syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+unsigned char* mapRing(int ringFd, size_t size, off_t offset)
+{
+    auto* memory =
+        mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ringFd, offset);
+    if (memory == MAP_FAILED)
+        throwRingError("can't map io_uring");
+    return static_cast<unsigned char*>(memory);
+}
+} // namespace
+
+// NOTE: The rings are shared with the kernel. We own the tail of the submission ring and the head
+// of the completion ring, the kernel owns the others
+struct IoRingFile::Rings
+{
+    Rings(int ringFd, const io_uring_params& params)
+    {
+        sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        // NOTE: Since Linux 5.4 both rings are mapped at once
+        const bool isSingleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (isSingleMap)
+            sqRingSize = cqRingSize = std::max(sqRingSize, cqRingSize);
+
+        sqRing = mapRing(ringFd, sqRingSize, IORING_OFF_SQ_RING);
+        cqRing = isSingleMap ? sqRing : mapRing(ringFd, cqRingSize, IORING_OFF_CQ_RING);
+        sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        sqes = reinterpret_cast<io_uring_sqe*>(mapRing(ringFd, sqesSize, IORING_OFF_SQES));
+
+        sqTail = reinterpret_cast<unsigned*>(sqRing + params.sq_off.tail);
+        sqMask = *reinterpret_cast<unsigned*>(sqRing + params.sq_off.ring_mask);
+        sqArray = reinterpret_cast<unsigned*>(sqRing + params.sq_off.array);
+        cqHead = reinterpret_cast<unsigned*>(cqRing + params.cq_off.head);
+        cqTail = reinterpret_cast<unsigned*>(cqRing + params.cq_off.tail);
+        cqMask = *reinterpret_cast<unsigned*>(cqRing + params.cq_off.ring_mask);
+        cqes = reinterpret_cast<io_uring_cqe*>(cqRing + params.cq_off.cqes);
+    }
+
+    Rings(const Rings&) = delete;
+    Rings& operator=(const Rings&) = delete;
+
+    ~Rings()
+    {
+        if (sqes)
+            munmap(sqes, sqesSize);
+        if (cqRing && cqRing != sqRing)
+            munmap(cqRing, cqRingSize);
+        if (sqRing)
+            munmap(sqRing, sqRingSize);
+    }
+
+    unsigned char* sqRing = nullptr;
+    size_t sqRingSize = 0;
+    unsigned char* cqRing = nullptr;
+    size_t cqRingSize = 0;
+    io_uring_sqe* sqes = nullptr;
+    size_t sqesSize = 0;
+
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+};
+
+IoRingFile::IoRingFile(const std::string& path, unsigned queueDepth, bool isDirect)
+    : queueDepth_(queueDepth)
+{
+    assert(queueDepth != 0);
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        throwRingError("can't open the file " + path);
+
+    try
+    {
+        if (isDirect)
+        {
+#ifdef O_DIRECT
+            directFd_ = ::open(path.c_str(), O_RDONLY | O_DIRECT);
+            if (directFd_ < 0)
+                throwRingError("can't open the file " + path + " for direct reading");
+#else
+            throwRingError("can't open the file " + path + " for direct reading", ENOTSUP);
+#endif
+        }
+
+        struct stat fileStat;
+        if (fstat(fd_, &fileStat) != 0)
+            throwRingError("can't get the size of the file " + path);
+        size_ = static_cast<uintmax_t>(fileStat.st_size);
+
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        ringFd_ = setupRing(queueDepth, params);
+        if (ringFd_ < 0)
+            throwRingError("can't set up io_uring");
+        // NOTE: The reads are completed through IORING_OP_READ, which came with Linux 5.6 along
+        // with this feature
+        if (!(params.features & IORING_FEAT_RW_CUR_POS))
+            throwRingError("io_uring of this kernel can't read files", ENOTSUP);
+        rings_ = std::make_unique<Rings>(ringFd_, params);
+    }
+    catch (...)
+    {
+        if (ringFd_ >= 0)
+            ::close(ringFd_);
+        if (directFd_ >= 0)
+            ::close(directFd_);
+        ::close(fd_);
+        throw;
+    }
+}
+
+IoRingFile::~IoRingFile()
+{
+    try
+    {
+        submit();
+        std::vector<Completion> completions;
+        while (inFlightCnt_ != 0)
+            reap(completions, inFlightCnt_);
+    }
+    catch (...)
+    {
+        // NOTE: The kernel cancels the reads left when the ring is closed
+    }
+    rings_.reset();
+    ::close(ringFd_);
+    if (directFd_ >= 0)
+        ::close(directFd_);
+    ::close(fd_);
+}
+
+bool IoRingFile::isSupported()
+{
+    static const bool isSupported = []() {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+        const auto ringFd = setupRing(1, params);
+        if (ringFd < 0)
+            return false;
+        ::close(ringFd);
+        return (params.features & IORING_FEAT_RW_CUR_POS) != 0;
+    }();
+    return isSupported;
+}
+
+bool IoRingFile::registerBuffer(void* data, size_t size) noexcept
+{
+    assert(!registeredBuffer_);
+    std::vector<iovec> parts;
+    for (size_t offset = 0; offset < size; offset += MaxRegisteredBufferSize)
+    {
+        parts.push_back({.iov_base = static_cast<unsigned char*>(data) + offset,
+                         .iov_len = std::min(size - offset, MaxRegisteredBufferSize)});
+    }
+    if (parts.empty() ||
+        syscall(__NR_io_uring_register,
+                ringFd_,
+                IORING_REGISTER_BUFFERS,
+                parts.data(),
+                static_cast<unsigned>(parts.size())) < 0)
+    {
+        return false;
+    }
+    registeredBuffer_ = static_cast<const unsigned char*>(data);
+    registeredBufferSize_ = size;
+    return true;
+}
+
+bool IoRingFile::prepareRead(void* dest, size_t size, uintmax_t pos, uint64_t userData) noexcept
+{
+    assert(size != 0);
+    if (preparedCnt_ + inFlightCnt_ >= queueDepth_)
+        return false;
+
+    const auto tail = *rings_->sqTail;
+    const auto idx = tail & rings_->sqMask;
+    auto& sqe = rings_->sqes[idx];
+    std::memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_READ;
+    sqe.fd = fd_;
+    sqe.addr = reinterpret_cast<uint64_t>(dest);
+    sqe.len = static_cast<uint32_t>(std::min(size, MaxReadSize));
+    sqe.off = pos;
+    sqe.user_data = userData;
+    if (directFd_ >= 0 && sqe.addr % DirectIoAlignment == 0 && pos % DirectIoAlignment == 0 &&
+        sqe.len % DirectIoAlignment == 0)
+    {
+        sqe.fd = directFd_;
+    }
+
+    // NOTE: A read into the registered memory must fit into one of its parts
+    const auto* begin = static_cast<const unsigned char*>(dest);
+    if (registeredBuffer_ && begin >= registeredBuffer_ &&
+        begin + sqe.len <= registeredBuffer_ + registeredBufferSize_)
+    {
+        const auto offset = static_cast<size_t>(begin - registeredBuffer_);
+        const auto partIdx = offset / MaxRegisteredBufferSize;
+        if ((offset + sqe.len - 1) / MaxRegisteredBufferSize == partIdx)
+        {
+            sqe.opcode = IORING_OP_READ_FIXED;
+            sqe.buf_index = static_cast<uint16_t>(partIdx);
+        }
+    }
+
+    rings_->sqArray[idx] = idx;
+    __atomic_store_n(rings_->sqTail, tail + 1, __ATOMIC_RELEASE);
+    preparedCnt_++;
+    return true;
+}
+
+void IoRingFile::submit()
+{
+    while (preparedCnt_ != 0)
+    {
+        const auto submitted = enterRing(ringFd_, preparedCnt_, 0, 0);
+        if (submitted < 0 && errno == EINTR)
+            continue;
+        if (submitted <= 0)
+            throwRingError("can't submit reads to io_uring", submitted < 0 ? errno : EAGAIN);
+        preparedCnt_ -= static_cast<unsigned>(submitted);
+        inFlightCnt_ += static_cast<unsigned>(submitted);
+    }
+}
+
+void IoRingFile::reap(std::vector<Completion>& completions, unsigned minCompletions)
+{
+    minCompletions = std::min(minCompletions, inFlightCnt_);
+    unsigned reapedCnt = 0;
+    while (true)
+    {
+        auto head = *rings_->cqHead;
+        const auto tail = __atomic_load_n(rings_->cqTail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++, reapedCnt++)
+        {
+            const auto& cqe = rings_->cqes[head & rings_->cqMask];
+            completions.push_back({.userData = cqe.user_data, .result = cqe.res});
+        }
+        __atomic_store_n(rings_->cqHead, head, __ATOMIC_RELEASE);
+        inFlightCnt_ -= std::min(reapedCnt, inFlightCnt_);
+        if (reapedCnt >= minCompletions)
+            return;
+
+        minCompletions -= reapedCnt;
+        reapedCnt = 0;
+        if (enterRing(ringFd_, 0, minCompletions, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+            throwRingError("can't wait for io_uring");
+    }
+}
+#else
+struct IoRingFile::Rings
+{
+};
+
+IoRingFile::IoRingFile(const std::string&, unsigned queueDepth, bool) : queueDepth_(queueDepth)
+{
+    throw std::fstream::failure("io_uring isn't supported on this system");
+}
+
+IoRingFile::~IoRingFile() = default;
+
+bool IoRingFile::isSupported()
+{
+    return false;
+}
+
+bool IoRingFile::registerBuffer(void*, size_t) noexcept
+{
+    return false;
+}
+
+bool IoRingFile::prepareRead(void*, size_t, uintmax_t, uint64_t) noexcept
+{
+    return false;
+}
+
+void IoRingFile::submit()
+{
+}
+
+void IoRingFile::reap(std::vector<Completion>&, unsigned)
+{
+}
+#endif
+
+uintmax_t IoRingFile::size() const noexcept
+{
+    return size_;
+}
+
+unsigned IoRingFile::queueDepth() const noexcept
+{
+    return queueDepth_;
+}
+
+unsigned IoRingFile::inFlightCount() const noexcept
+{
+    return inFlightCnt_;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// NOTE: A file read through io_uring. Reads are queued into the submission ring and performed by
+// the kernel asynchronously, so a single thread keeps many of them in flight. The ring is set up
+// with the system calls directly, liburing isn't required. The memory the reads go to may be
+// registered once, then the kernel doesn't pin its pages on every read
+class IoRingFile
+{
+public:
+    struct Completion
+    {
+        uint64_t userData = 0;
+        // NOTE: The number of bytes read or a negated errno
+        int result = 0;
+    };
+
+public:
+    // NOTE: The direct file is read with O_DIRECT where the memory, the position and the size of a
+    // read are aligned to DirectIoAlignment, the other reads go through the page cache. Throws if
+    // the file can't be opened with O_DIRECT, e.g. the file system doesn't support it
+    IoRingFile(const std::string& path, unsigned queueDepth, bool isDirect = false);
+    IoRingFile(const IoRingFile&) = delete;
+    IoRingFile& operator=(const IoRingFile&) = delete;
+    // NOTE: Waits for the reads in flight, the memory they go to may be freed only afterwards
+    ~IoRingFile();
+
+    // NOTE: False when the system or a sandbox doesn't let io_uring be used
+    static bool isSupported();
+
+    [[nodiscard]] uintmax_t size() const noexcept;
+    [[nodiscard]] unsigned queueDepth() const noexcept;
+    [[nodiscard]] unsigned inFlightCount() const noexcept;
+
+    // NOTE: Returns false if the system refuses to pin the memory, e.g. over RLIMIT_MEMLOCK. The
+    // reads go to any memory anyway, the registered one is only faster. Is called once
+    bool registerBuffer(void* data, size_t size) noexcept;
+
+    // NOTE: Queues a read, it's passed to the kernel by submit(). Returns false when queueDepth
+    // reads are already queued or in flight. A read may be short, big ones always are, the caller
+    // queues the rest again
+    bool prepareRead(void* dest, size_t size, uintmax_t pos, uint64_t userData) noexcept;
+    void submit();
+    // NOTE: Waits until at least minCompletions reads are completed and appends all the completed
+    // ones
+    void reap(std::vector<Completion>& completions, unsigned minCompletions);
+
+private:
+    struct Rings;
+
+    int fd_ = -1;
+    int directFd_ = -1;
+    int ringFd_ = -1;
+    uintmax_t size_ = 0;
+    unsigned queueDepth_ = 0;
+    std::unique_ptr<Rings> rings_;
+    unsigned preparedCnt_ = 0;
+    unsigned inFlightCnt_ = 0;
+
+    const unsigned char* registeredBuffer_ = nullptr;
+    size_t registeredBufferSize_ = 0;
+};
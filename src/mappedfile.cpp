@@ -0,0 +1,121 @@
+#include "mappedfile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <fstream>
+#include <system_error>
+
+#if __has_include(<sys/mman.h>) && __has_include(<unistd.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MMAP_AVAILABLE
+#endif
+
+namespace
+{
+[[noreturn]] void throwMappingError(const std::string& what)
+{
+    throw std::fstream::failure(what, std::error_code(errno, std::generic_category()));
+}
+
+#ifdef MMAP_AVAILABLE
+const uintmax_t PageSize = static_cast<uintmax_t>(sysconf(_SC_PAGESIZE));
+#endif
+} // namespace
+
+MappedFile::MappedFile(const std::string& path)
+    : path_(path)
+{
+#ifdef MMAP_AVAILABLE
+    // NOTE: The mapping keeps the file open itself, the descriptor is kept for the size checks and
+    // the hole queries
+    fd_ = ::open(path.c_str(), O_RDONLY);
+    if (fd_ < 0)
+        throwMappingError("can't open the file " + path);
+
+    struct stat fileStat;
+    if (fstat(fd_, &fileStat) != 0)
+    {
+        const auto error = errno;
+        ::close(fd_);
+        errno = error;
+        throwMappingError("can't get the size of the file " + path);
+    }
+    size_ = static_cast<size_t>(fileStat.st_size);
+    // NOTE: An empty file can't be mapped, it has nothing to read anyway
+    if (size_ == 0)
+        return;
+
+    auto* memory = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd_, 0);
+    if (memory == MAP_FAILED)
+    {
+        const auto error = errno;
+        ::close(fd_);
+        errno = error;
+        throwMappingError("can't map the file " + path);
+    }
+    memory_ = static_cast<unsigned char*>(memory);
+
+#ifdef MADV_SEQUENTIAL
+    // NOTE: The system reads ahead more aggressively and drops the pages behind sooner
+    madvise(memory_, size_, MADV_SEQUENTIAL);
+#endif
+#else
+    throw std::fstream::failure("memory mapped files aren't supported on this system");
+#endif
+}
+
+MappedFile::~MappedFile()
+{
+#ifdef MMAP_AVAILABLE
+    if (memory_)
+        munmap(memory_, size_);
+    if (fd_ != -1)
+        ::close(fd_);
+#endif
+}
+
+ConstDataIterator MappedFile::data() const noexcept
+{
+    return memory_;
+}
+
+uintmax_t MappedFile::size() const noexcept
+{
+    return size_;
+}
+
+void MappedFile::adviseWillNeed(uintmax_t offset, uintmax_t size) const noexcept
+{
+#if defined(MMAP_AVAILABLE) && defined(MADV_WILLNEED)
+    if (offset >= size_)
+        return;
+    // NOTE: madvise() takes page aligned addresses
+    const auto begin = offset / PageSize * PageSize;
+    const auto end = std::min<uintmax_t>(offset + size, size_);
+    madvise(memory_ + begin, static_cast<size_t>(end - begin), MADV_WILLNEED);
+#else
+    static_cast<void>(offset);
+    static_cast<void>(size);
+#endif
+}
+
+void MappedFile::throwIfTruncated(uintmax_t end) const
+{
+#ifdef MMAP_AVAILABLE
+    struct stat fileStat;
+    if (fstat(fd_, &fileStat) != 0)
+        throwMappingError("can't get the size of the file " + path_);
+    if (static_cast<uintmax_t>(fileStat.st_size) < std::min<uintmax_t>(end, size_))
+        throw std::fstream::failure("the file " + path_ + " has been truncated while being read");
+#else
+    static_cast<void>(end);
+#endif
+}
+
+std::vector<BytesInterval> MappedFile::findDataExtents(uintmax_t begin, uintmax_t end) const
+{
+    return ::findDataExtents(fd_, begin, end);
+}
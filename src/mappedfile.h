@@ -0,0 +1,42 @@
+#pragma once
+
+#include "defs.h"
+#include "sparsefile.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// NOTE: A file mapped into memory for reading. The pages are shared with the page cache and are
+// read by the system on the first touch, so a cached file is hashed without a copy and its bytes
+// aren't charged to the RAM budget. The mapping is advised to be read sequentially, the pages about
+// to be hashed may be requested in advance.
+// Touching a page past the end of a file truncated after the mapping raises SIGBUS, so the size is
+// checked before a range is handed out. It narrows the window rather than closes it: the file may
+// still be cut while the range is hashed
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    [[nodiscard]] ConstDataIterator data() const noexcept;
+    [[nodiscard]] uintmax_t size() const noexcept;
+
+    // NOTE: Asks the system to read the range in the background. It's only a hint
+    void adviseWillNeed(uintmax_t offset, uintmax_t size) const noexcept;
+
+    // NOTE: Throws if the file has become shorter than the end of the range, which is clipped to
+    // the mapped size
+    void throwIfTruncated(uintmax_t end) const;
+    // NOTE: The same as findDataExtents() for the mapped file
+    [[nodiscard]] std::vector<BytesInterval> findDataExtents(uintmax_t begin, uintmax_t end) const;
+
+private:
+    std::string path_;
+    int fd_ = -1;
+    unsigned char* memory_ = nullptr;
+    size_t size_ = 0;
+};
@@ -0,0 +1,126 @@
+#include "memoryarena.h"
+#include "memorysizeliterals.h"
+
+#include <cassert>
+#include <new>
+
+#if __has_include(<sys/mman.h>)
+#include <sys/mman.h>
+#define MMAP_AVAILABLE
+#endif
+
+namespace
+{
+constexpr size_t PageSize = 4 * KB;
+constexpr size_t HugePageSize = 2 * MB;
+constexpr size_t CacheLineSize = 64;
+
+size_t alignUp(size_t value, size_t alignment)
+{
+    return (value + alignment - 1) / alignment * alignment;
+}
+} // namespace
+
+namespace Parallel
+{
+MemoryArena::MemoryArena(size_t size, bool isPrefaulted)
+    : size_(size)
+{
+    if (size_ == 0)
+        return;
+
+    reserve();
+    if (isPrefaulted)
+        prefault();
+}
+
+MemoryArena::~MemoryArena()
+{
+    if (!memory_)
+        return;
+
+#ifdef MMAP_AVAILABLE
+    munmap(memory_, size_);
+#else
+    operator delete(memory_, std::align_val_t{PageSize});
+#endif
+}
+
+void MemoryArena::reserve()
+{
+#ifdef MMAP_AVAILABLE
+    constexpr int protection = PROT_READ | PROT_WRITE;
+    constexpr int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_HUGETLB
+    // NOTE: It succeeds only if enough huge pages are reserved in the system (vm.nr_hugepages).
+    // MAP_NORESERVE isn't used here, since a fault on a missing huge page would kill the process
+    const auto hugePagesSize = alignUp(size_, HugePageSize);
+    auto* hugePagesMemory = mmap(nullptr, hugePagesSize, protection, flags | MAP_HUGETLB, -1, 0);
+    if (hugePagesMemory != MAP_FAILED)
+    {
+        memory_ = static_cast<unsigned char*>(hugePagesMemory);
+        size_ = hugePagesSize;
+        isBackedByHugePages_ = true;
+        return;
+    }
+#endif
+
+    auto* memory = mmap(nullptr, size_, protection, flags | MAP_NORESERVE, -1, 0);
+    if (memory == MAP_FAILED)
+        throw std::bad_alloc();
+    memory_ = static_cast<unsigned char*>(memory);
+
+#ifdef MADV_HUGEPAGE
+    // NOTE: Transparent huge pages are only a hint, the arena works without them
+    isBackedByHugePages_ = madvise(memory_, size_, MADV_HUGEPAGE) == 0;
+#endif
+#else
+    memory_ = static_cast<unsigned char*>(operator new(size_, std::align_val_t{PageSize}));
+#endif
+}
+
+void MemoryArena::prefault()
+{
+    // NOTE: Writing to every page makes the system back it with physical memory. The pages are
+    // written with zeroes, so the content doesn't change
+    for (size_t offset = 0; offset < size_; offset += PageSize)
+        static_cast<volatile unsigned char*>(memory_)[offset] = 0;
+}
+
+void* MemoryArena::allocate(size_t n)
+{
+    const auto alignment = n >= PageSize ? PageSize : CacheLineSize;
+    const auto alignedSize = alignUp(n, alignment);
+
+    auto usedSize = usedSize_.load();
+    while (true)
+    {
+        const auto begin = alignUp(usedSize, alignment);
+        if (begin > size_ || size_ - begin < alignedSize)
+            return nullptr;
+        if (usedSize_.compare_exchange_weak(usedSize, begin + alignedSize))
+            return memory_ + begin;
+    }
+}
+
+void* MemoryArena::data() const noexcept
+{
+    return memory_;
+}
+
+size_t MemoryArena::size() const noexcept
+{
+    return size_;
+}
+
+size_t MemoryArena::usedSize() const noexcept
+{
+    return usedSize_.load();
+}
+
+bool MemoryArena::isBackedByHugePages() const noexcept
+{
+    return isBackedByHugePages_;
+}
+} // namespace Parallel
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace Parallel
+{
+// NOTE: A memory region reserved once and handed out by a lock-free bump allocator. Memory isn't
+// returned to the arena until it's destroyed, it suits memory pools which keep their chunks anyway.
+// The region is backed by huge pages when the system has them reserved, otherwise transparent huge
+// pages are requested. Pre-faulting moves all the page faults to the construction
+class MemoryArena
+{
+public:
+    explicit MemoryArena(size_t size, bool isPrefaulted = false);
+    MemoryArena(const MemoryArena&) = delete;
+    MemoryArena& operator=(const MemoryArena&) = delete;
+    ~MemoryArena();
+
+    // NOTE: Returns nullptr when the arena is exhausted. Chunks of a page size and more are aligned
+    // to the page size
+    void* allocate(size_t n);
+
+    // NOTE: The whole region, e.g. to register it for io_uring reads
+    void* data() const noexcept;
+    size_t size() const noexcept;
+    size_t usedSize() const noexcept;
+    bool isBackedByHugePages() const noexcept;
+
+private:
+    void reserve();
+    void prefault();
+
+private:
+    unsigned char* memory_ = nullptr;
+    size_t size_ = 0;
+    bool isBackedByHugePages_ = false;
+    std::atomic<size_t> usedSize_ = 0;
+};
+using MemoryArenaPtr = std::shared_ptr<MemoryArena>;
+} // namespace Parallel
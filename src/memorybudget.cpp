@@ -0,0 +1,133 @@
+#include "memorybudget.h"
+
+#include <algorithm>
+#include <cassert>
+#include <vector>
+
+namespace Parallel
+{
+namespace
+{
+struct ThreadReservation
+{
+    const MemoryBudget* budget;
+    size_t bytes;
+};
+
+// NOTE: A thread usually holds a reservation or two at a time, e.g. of the input and the output
+// budgets of a fused step
+thread_local std::vector<ThreadReservation> threadReservations;
+
+auto findThreadReservation(const MemoryBudget* budget)
+{
+    return std::find_if(threadReservations.begin(),
+                        threadReservations.end(),
+                        [budget](const auto& reservation) { return reservation.budget == budget; });
+}
+} // namespace
+
+MemoryBudget::Reservation::Reservation(MemoryBudget& budget)
+    : budget_(&budget)
+{
+}
+
+MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+    : budget_(other.budget_)
+{
+    other.budget_ = nullptr;
+}
+
+MemoryBudget::Reservation::~Reservation()
+{
+    if (!budget_)
+        return;
+
+    const auto it = findThreadReservation(budget_);
+    assert(it != threadReservations.end());
+    const auto bytesLeft = it->bytes;
+    threadReservations.erase(it);
+    if (bytesLeft != 0)
+        budget_->release(bytesLeft);
+}
+
+MemoryBudget::MemoryBudget(size_t size)
+    : size_(size)
+{
+}
+
+void MemoryBudget::acquire(size_t bytes)
+{
+    const auto reservationIt = findThreadReservation(this);
+    if (reservationIt != threadReservations.end() && reservationIt->bytes >= bytes)
+    {
+        reservationIt->bytes -= bytes;
+        return;
+    }
+
+    auto bytesInUse = bytesInUse_.load();
+    while (true)
+    {
+        if (fits(bytesInUse, bytes))
+        {
+            if (bytesInUse_.compare_exchange_weak(bytesInUse, bytesInUse + bytes))
+                return;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lk(mut_);
+        waitersCount_++;
+        cond_.wait(lk, [this, bytes]() { return fits(bytesInUse_.load(), bytes); });
+        waitersCount_--;
+        bytesInUse = bytesInUse_.load();
+    }
+}
+
+void MemoryBudget::release(size_t bytes)
+{
+    assert(bytesInUse_.load() >= bytes);
+    bytesInUse_ -= bytes;
+    // NOTE: Waiters check the budget under the mutex, so taking it here guarantees that a waiter
+    // either sees the released bytes or is already waiting for the notification. All of them are
+    // notified since the released bytes may be enough for a waiter which wants less
+    if (waitersCount_.load() != 0)
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        cond_.notify_all();
+    }
+}
+
+std::optional<MemoryBudget::Reservation> MemoryBudget::tryReserve(size_t bytes)
+{
+    assert(findThreadReservation(this) == threadReservations.end());
+    if (!tryAcquire(bytes))
+        return std::nullopt;
+    threadReservations.push_back({this, bytes});
+    return Reservation(*this);
+}
+
+bool MemoryBudget::tryAcquire(size_t bytes)
+{
+    auto bytesInUse = bytesInUse_.load();
+    while (fits(bytesInUse, bytes))
+    {
+        if (bytesInUse_.compare_exchange_weak(bytesInUse, bytesInUse + bytes))
+            return true;
+    }
+    return false;
+}
+
+size_t MemoryBudget::size() const noexcept
+{
+    return size_;
+}
+
+size_t MemoryBudget::bytesInUse() const noexcept
+{
+    return bytesInUse_.load();
+}
+
+bool MemoryBudget::fits(size_t bytesInUse, size_t bytes) const noexcept
+{
+    return bytesInUse == 0 || (bytes <= size_ && bytesInUse <= size_ - bytes);
+}
+} // namespace Parallel
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <optional>
+
+namespace Parallel
+{
+// NOTE: Counts the bytes in use by all the stages which share the budget. acquire() waits until
+// the bytes fit into the budget, so the stages are slowed down by the bytes in flight rather than
+// by the number of elements in their queues. A request bigger than the whole budget is let through
+// when nothing else is in use, otherwise it would wait forever
+class MemoryBudget
+{
+public:
+    // NOTE: Bytes acquired in advance by a thread, its acquire() calls take them without waiting.
+    // The bytes left are released when the reservation is destroyed, which must happen on the same
+    // thread. It lets a step of a StageScheduler check that the memory it needs is there and
+    // return NoWork otherwise, instead of waiting for it
+    class Reservation
+    {
+    public:
+        Reservation(Reservation&& other) noexcept;
+        Reservation& operator=(Reservation&&) = delete;
+        ~Reservation();
+
+    private:
+        explicit Reservation(MemoryBudget& budget);
+
+    private:
+        MemoryBudget* budget_;
+
+        friend MemoryBudget;
+    };
+
+public:
+    explicit MemoryBudget(size_t size);
+    MemoryBudget(const MemoryBudget&) = delete;
+    MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+    void acquire(size_t bytes);
+    void release(size_t bytes);
+    // NOTE: Returns nothing if the bytes don't fit into the budget right now. A thread may have a
+    // single reservation of a budget at a time
+    std::optional<Reservation> tryReserve(size_t bytes);
+
+    size_t size() const noexcept;
+    size_t bytesInUse() const noexcept;
+
+private:
+    bool fits(size_t bytesInUse, size_t bytes) const noexcept;
+    bool tryAcquire(size_t bytes);
+
+private:
+    const size_t size_;
+    std::atomic<size_t> bytesInUse_ = 0;
+    std::atomic<size_t> waitersCount_ = 0;
+    std::mutex mut_;
+    std::condition_variable cond_;
+};
+using MemoryBudgetPtr = std::shared_ptr<MemoryBudget>;
+} // namespace Parallel
@@ -0,0 +1,145 @@
+#include "numatopology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define THREAD_PINNING_SUPPORTED
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr auto NumaNodesDirectory = "/sys/devices/system/node";
+constexpr std::string_view NodeDirectoryPrefix = "node";
+
+std::optional<unsigned> parseUnsigned(std::string_view str)
+{
+    unsigned result = 0;
+    const auto [end, error] = std::from_chars(str.data(), str.data() + str.size(), result);
+    if (error != std::errc() || end != str.data() + str.size())
+        return std::nullopt;
+    return result;
+}
+
+#ifdef THREAD_PINNING_SUPPORTED
+std::vector<unsigned> getCurrentThreadCpus()
+{
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    if (pthread_getaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) != 0)
+        return {};
+
+    std::vector<unsigned> cpus;
+    for (unsigned cpu = 0; cpu < CPU_SETSIZE; cpu++)
+    {
+        if (CPU_ISSET(cpu, &cpuSet))
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+bool setCurrentThreadCpus(const std::vector<unsigned>& cpus)
+{
+    cpu_set_t cpuSet;
+    CPU_ZERO(&cpuSet);
+    for (auto cpu : cpus)
+    {
+        if (cpu < CPU_SETSIZE)
+            CPU_SET(cpu, &cpuSet);
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpuSet), &cpuSet) == 0;
+}
+#endif
+} // namespace
+
+namespace Parallel
+{
+std::vector<unsigned> parseCpuList(std::string_view cpuList)
+{
+    std::vector<unsigned> cpus;
+    while (!cpuList.empty())
+    {
+        const auto rangeEnd = std::min(cpuList.find(','), cpuList.size());
+        auto range = cpuList.substr(0, rangeEnd);
+        cpuList.remove_prefix(std::min(rangeEnd + 1, cpuList.size()));
+
+        while (!range.empty() && std::isspace(static_cast<unsigned char>(range.back())))
+            range.remove_suffix(1);
+        if (range.empty())
+            continue;
+
+        const auto dashPos = range.find('-');
+        const auto first = parseUnsigned(range.substr(0, dashPos));
+        const auto last =
+            dashPos == std::string_view::npos ? first : parseUnsigned(range.substr(dashPos + 1));
+        if (!first || !last || *first > *last)
+            return {};
+
+        for (auto cpu = *first; cpu <= *last; cpu++)
+            cpus.push_back(cpu);
+    }
+    return cpus;
+}
+
+std::vector<NumaNode> getNumaNodes()
+{
+    std::vector<NumaNode> nodes;
+    std::error_code error;
+    for (const auto& entry : fs::directory_iterator(NumaNodesDirectory, error))
+    {
+        const auto name = entry.path().filename().string();
+        if (name.rfind(NodeDirectoryPrefix, 0) != 0)
+            continue;
+        const auto id = parseUnsigned(std::string_view(name).substr(NodeDirectoryPrefix.size()));
+        if (!id)
+            continue;
+
+        std::ifstream cpuListFile(entry.path() / "cpulist");
+        std::string cpuList;
+        std::getline(cpuListFile, cpuList);
+
+        // NOTE: Memory-only nodes have no cpus, there is nobody to process their frames
+        auto cpus = parseCpuList(cpuList);
+        if (!cpus.empty())
+            nodes.push_back({*id, std::move(cpus)});
+    }
+
+    std::sort(nodes.begin(), nodes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.id < rhs.id;
+    });
+    return nodes;
+}
+
+ThreadPinning::ThreadPinning(const std::vector<unsigned>& cpus)
+{
+#ifdef THREAD_PINNING_SUPPORTED
+    if (cpus.empty())
+        return;
+
+    previousCpus_ = getCurrentThreadCpus();
+    isPinned_ = !previousCpus_.empty() && setCurrentThreadCpus(cpus);
+#endif
+}
+
+ThreadPinning::~ThreadPinning()
+{
+#ifdef THREAD_PINNING_SUPPORTED
+    if (isPinned_)
+        setCurrentThreadCpus(previousCpus_);
+#endif
+}
+
+bool ThreadPinning::isPinned() const noexcept
+{
+    return isPinned_;
+}
+} // namespace Parallel
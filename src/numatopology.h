@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string_view>
+#include <vector>
+
+namespace Parallel
+{
+struct NumaNode
+{
+    unsigned id = 0;
+    std::vector<unsigned> cpus;
+};
+
+// NOTE: Nodes are read from /sys/devices/system/node. An empty result means the topology is unknown
+std::vector<NumaNode> getNumaNodes();
+
+// NOTE: Parses the cpu list format of the kernel, e.g. "0-3,8,10-11"
+std::vector<unsigned> parseCpuList(std::string_view cpuList);
+
+// NOTE: Pins the current thread to the cpus and restores its previous affinity on destruction, so a
+// thread of a shared thread pool doesn't stay pinned after the task. Does nothing if cpus are empty
+// or the system doesn't support pinning
+class ThreadPinning
+{
+public:
+    explicit ThreadPinning(const std::vector<unsigned>& cpus);
+    ThreadPinning(const ThreadPinning&) = delete;
+    ThreadPinning& operator=(const ThreadPinning&) = delete;
+    ~ThreadPinning();
+
+    bool isPinned() const noexcept;
+
+private:
+    std::vector<unsigned> previousCpus_;
+    bool isPinned_ = false;
+};
+} // namespace Parallel
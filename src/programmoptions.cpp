@@ -1,10 +1,13 @@
 #define BOOST_USE_ASAN
 
+#include "defs.h"
 #include "memorysizeliterals.h"
 #include "programmoptions.h"
 
 #include <boost/program_options.hpp>
 
+#include <numeric>
+
 namespace po = boost::program_options;
 
 namespace
@@ -57,7 +60,49 @@ std::variant<Options, std::string> getOptionsOrHelpStr(int argc, char const* arg
         ("max-ram-size,m",
          po::value<std::string>()->default_value("3GB"),
          "maximum size of RAM that will be used by the programm."
-         "Supports KB, MB, GB literals.");
+         "Supports KB, MB, GB literals.")
+        ("checksum,c",
+         po::value<std::string>()->default_value("crc8"),
+         "checksum algorithm, the signature contains one digest of its width per block. "
+         "Possible values: crc8, crc16, crc32, crc32c, crc64")
+        ("prefault-memory",
+         po::bool_switch(),
+         "touch all the memory for data blocks at startup, so no page faults happen during "
+         "processing. It makes the program use max-ram-size of RAM from the very beginning")
+        ("numa",
+         po::bool_switch(),
+         "place data blocks in the memory of the NUMA node whose cores read and hash them. "
+         "It does nothing on systems with a single NUMA node")
+        ("fused",
+         po::bool_switch(),
+         "read and hash every data frame by the same worker while it's still in the CPU cache. "
+         "It suits files in the page cache or on NVMe drives, where reading isn't a bottleneck")
+        ("mmap",
+         po::bool_switch(),
+         "map the input file into memory and hash its pages in place, without copying them to "
+         "data blocks. It's the fastest when the file is in the page cache")
+        ("direct",
+         po::bool_switch(),
+         "read the input file with O_DIRECT, bypassing the page cache, so hashing a huge file "
+         "doesn't evict the cached data of other programs. The frames are aligned to 4KB, blocks "
+         "which can't be aligned within the frame size limit are rejected. It's ignored with "
+         "--mmap")
+        ("io-depth",
+         po::value<size_t>()->default_value(0),
+         "read the input file through io_uring keeping this many reads in flight, e.g. 32 for "
+         "NVMe drives. 0 means a stream per reader. It can't be used with --fused and it's ignored "
+         "with --mmap or where io_uring isn't available")
+        ("threads",
+         po::value<size_t>()->default_value(0),
+         "number of worker threads, at least 3. By default one less than the number of cores")
+        ("readers",
+         po::value<size_t>()->default_value(0),
+         "number of threads which may read the input file at a time. By default it's tuned "
+         "during the run to the number which reads the fastest")
+        ("hashers",
+         po::value<size_t>()->default_value(0),
+         "number of threads which may hash data blocks at a time. By default every idle thread "
+         "may");
 
     po::variables_map vm;
     po::store(po::parse_command_line(argc, argv, desc), vm);
@@ -74,9 +119,53 @@ std::variant<Options, std::string> getOptionsOrHelpStr(int argc, char const* arg
     if (hardDiskType != "SSD" && hardDiskType != "HDD")
         throw po::error("wrong hard disk type: " + hardDiskType + ". Correct values: HDD, SSD");
 
+    const auto checksumName = vm.at("checksum").as<std::string>();
+    const auto checksum = checksumAlgorithmByName(checksumName);
+    if (!checksum)
+    {
+        throw po::error("wrong checksum algorithm: " + checksumName +
+                        ". Correct values: crc8, crc16, crc32, crc32c, crc64");
+    }
+
+    const auto threadsCount = vm.at("threads").as<size_t>();
+    if (threadsCount != 0 && threadsCount < MinThreadsCount)
+        throw po::error("wrong threads count: " + std::to_string(threadsCount) +
+                        ". It must be at least " + std::to_string(MinThreadsCount));
+
+    const auto ioQueueDepth = vm.at("io-depth").as<size_t>();
+    if (ioQueueDepth > MaxIoQueueDepth)
+        throw po::error("wrong io depth: " + std::to_string(ioQueueDepth) +
+                        ". It must be at most " + std::to_string(MaxIoQueueDepth));
+    // NOTE: In the fused mode every reader hashes its own frame, there's no single reader to own
+    // the ring
+    if (ioQueueDepth != 0 && vm.at("fused").as<bool>())
+        throw po::error("--io-depth can't be used with --fused");
+
+    // NOTE: A direct frame is a whole number of blocks and of pages, there's no room for the
+    // smallest one of them. The limit of the frames depends on the input as well, so the rest is
+    // checked when the job is set up
+    const auto blockSize = parseMemorySize(vm.at("size-of-block").as<std::string>());
+    const auto maxRamSize = parseMemorySize(vm.at("max-ram-size").as<std::string>());
+    if (vm.at("direct").as<bool>() && !vm.at("mmap").as<bool>() && blockSize != 0 &&
+        std::lcm(blockSize, DirectIoAlignment) > maxRamSize)
+    {
+        throw po::error("--direct can't align the frames of such blocks to 4KB within the max RAM "
+                        "size. Use blocks which are a multiple or a divisor of 4KB");
+    }
+
     return Options{.inputFile = vm.at("input-file").as<std::string>(),
                    .outputFile = vm.at("output-file").as<std::string>(),
-                   .blockSize = parseMemorySize(vm.at("size-of-block").as<std::string>()),
+                   .blockSize = blockSize,
                    .isSSD = hardDiskType == "SSD",
-                   .maxRamSize = parseMemorySize(vm.at("max-ram-size").as<std::string>())};
+                   .maxRamSize = maxRamSize,
+                   .checksum = *checksum,
+                   .isMemoryPrefaulted = vm.at("prefault-memory").as<bool>(),
+                   .isNumaAware = vm.at("numa").as<bool>(),
+                   .isReadAndHashFused = vm.at("fused").as<bool>(),
+                   .isInputMapped = vm.at("mmap").as<bool>(),
+                   .isInputDirect = vm.at("direct").as<bool>(),
+                   .ioQueueDepth = ioQueueDepth,
+                   .threadsCount = threadsCount,
+                   .readersCount = vm.at("readers").as<size_t>(),
+                   .hashersCount = vm.at("hashers").as<size_t>()};
 }
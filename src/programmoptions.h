@@ -1,8 +1,16 @@
 #pragma once
 
+#include "checksum.h"
+
+#include <cstddef>
 #include <string>
 #include <variant>
 
+// NOTE: A thread per stage: reading, calculating and writing
+constexpr size_t MinThreadsCount = 3;
+// NOTE: io_uring takes up to 32768 entries, deeper queues don't pay off anyway
+constexpr size_t MaxIoQueueDepth = 4096;
+
 struct Options
 {
     std::string inputFile;
@@ -10,6 +18,18 @@ struct Options
     size_t blockSize;
     bool isSSD;
     size_t maxRamSize;
+    ChecksumAlgorithm checksum = ChecksumAlgorithm::Crc8;
+    bool isMemoryPrefaulted = false;
+    bool isNumaAware = false;
+    bool isReadAndHashFused = false;
+    bool isInputMapped = false;
+    bool isInputDirect = false;
+    // NOTE: Zero means the input is read with a stream per reader rather than through io_uring
+    size_t ioQueueDepth = 0;
+    // NOTE: Zero means the number is chosen by the program, the readers are tuned during the run
+    size_t threadsCount = 0;
+    size_t readersCount = 0;
+    size_t hashersCount = 0;
 };
 
 std::variant<Options, std::string> getOptionsOrHelpStr(int argc, char const* argv[]);
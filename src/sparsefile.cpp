@@ -0,0 +1,65 @@
+#include "sparsefile.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cerrno>
+
+#if __has_include(<unistd.h>)
+#include <unistd.h>
+#if defined(SEEK_DATA) && defined(SEEK_HOLE)
+#define SPARSE_FILES_SUPPORTED
+#endif
+#endif
+
+std::vector<BytesInterval> findDataExtents(int fd, uintmax_t begin, uintmax_t end)
+{
+#ifdef SPARSE_FILES_SUPPORTED
+    if (fd == -1)
+        return {{begin, end}};
+
+    std::vector<BytesInterval> extents;
+    for (auto pos = begin; pos < end;)
+    {
+        const auto dataBegin = ::lseek(fd, static_cast<off_t>(pos), SEEK_DATA);
+        // NOTE: ENXIO means there is no data after pos. Other errors mean that the file system
+        // doesn't support the query, so the whole interval is treated as data
+        if (dataBegin == -1)
+            return errno == ENXIO ? extents : std::vector<BytesInterval>{{begin, end}};
+        if (static_cast<uintmax_t>(dataBegin) >= end)
+            break;
+
+        const auto dataEnd = ::lseek(fd, dataBegin, SEEK_HOLE);
+        if (dataEnd == -1)
+            return {{begin, end}};
+
+        extents.push_back({static_cast<uintmax_t>(dataBegin),
+                           std::min(static_cast<uintmax_t>(dataEnd), end)});
+        pos = static_cast<uintmax_t>(dataEnd);
+    }
+    return extents;
+#else
+    static_cast<void>(fd);
+    return {{begin, end}};
+#endif
+}
+
+BlocksIntervals findHoleBlocks(const std::vector<BytesInterval>& dataExtents,
+                               uintmax_t frameBegin,
+                               size_t blockSize,
+                               size_t blocksCount)
+{
+    BlocksIntervals holes;
+    size_t firstNotDataBlock = 0;
+    for (const auto& extent : dataExtents)
+    {
+        const auto firstDataBlock = static_cast<size_t>((extent.begin - frameBegin) / blockSize);
+        if (firstNotDataBlock < firstDataBlock)
+            holes.push_back({firstNotDataBlock, firstDataBlock});
+        const auto dataBlocksEnd =
+            ceilDevision(static_cast<size_t>(extent.end - frameBegin), blockSize);
+        firstNotDataBlock = std::max(firstNotDataBlock, dataBlocksEnd);
+    }
+    if (firstNotDataBlock < blocksCount)
+        holes.push_back({firstNotDataBlock, blocksCount});
+    return holes;
+}
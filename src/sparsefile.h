@@ -0,0 +1,23 @@
+#pragma once
+
+#include "dataframe.h"
+
+#include <cstdint>
+#include <vector>
+
+struct BytesInterval
+{
+    uintmax_t begin = 0;
+    uintmax_t end = 0;
+};
+
+// NOTE: Returns the parts of [begin, end) of the open file which hold data, i.e. aren't holes of a
+// sparse file, queried with lseek(SEEK_DATA/SEEK_HOLE). If the descriptor is -1 or the file system
+// can't report holes, the whole interval is returned
+std::vector<BytesInterval> findDataExtents(int fd, uintmax_t begin, uintmax_t end);
+
+// NOTE: Marks as holes the blocks of the frame which don't intersect any data extent
+BlocksIntervals findHoleBlocks(const std::vector<BytesInterval>& dataExtents,
+                               uintmax_t frameBegin,
+                               size_t blockSize,
+                               size_t blocksCount);
@@ -0,0 +1,315 @@
+#include "stagescheduler.h"
+
+#include "numatopology.h"
+#include "utils.h"
+
+#include <boost/asio/post.hpp>
+
+#include <unordered_map>
+
+namespace Parallel
+{
+namespace
+{
+// NOTE: The workers of the jobs run on each of the shared pools. A pool is dropped when its last
+// reservation is, so the address of a destroyed pool may be reused
+std::mutex poolsMut;
+std::unordered_map<const boost::asio::thread_pool*, size_t> reservedPoolThreads;
+} // namespace
+
+StageScheduler::StageScheduler(size_t workersCount, std::vector<unsigned> cpus)
+    : workersCount_(workersCount)
+    , cpus_(std::move(cpus))
+{
+    assert(workersCount_ != 0);
+}
+
+size_t StageScheduler::addStage(Stage stage)
+{
+    assert(!pool_ && stage.step && stage.maxWorkers != 0);
+    stages_.push_back({.stage = std::move(stage)});
+    return stages_.size() - 1;
+}
+
+void StageScheduler::setMaxWorkers(size_t stageIdx, size_t maxWorkers)
+{
+    assert(maxWorkers != 0);
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        stages_[stageIdx].stage.maxWorkers = maxWorkers;
+    }
+    // NOTE: The parked workers may have work in the stage now
+    wakeUp(workersCount_);
+}
+
+void StageScheduler::run(boost::asio::thread_pool& pool)
+{
+    // NOTE: Every stage needs a worker of its own, otherwise the stages above may take them all
+    assert(!pool_ && !stages_.empty() && stages_.size() <= workersCount_);
+
+    pool_ = &pool;
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        pollTimer_.emplace(pool.get_executor());
+        runningWorkersCnt_ = workersCount_;
+    }
+    for (size_t i = 0; i < workersCount_; i++)
+        post();
+}
+
+void StageScheduler::notify()
+{
+    wakeUp(workersCount_);
+}
+
+void StageScheduler::joinAndRethrowExceptions()
+{
+    assert(pool_);
+    doneFuture_.wait();
+    std::lock_guard<std::mutex> lk(mut_);
+    if (exception_)
+        std::rethrow_exception(exception_);
+}
+
+size_t StageScheduler::workersCount() const noexcept
+{
+    return workersCount_;
+}
+
+void StageScheduler::work()
+{
+    try
+    {
+        ThreadPinning pinning(cpus_);
+        while (true)
+        {
+            size_t eventsCnt = 0;
+            {
+                std::lock_guard<std::mutex> lk(mut_);
+                if (isStopping())
+                    break;
+                eventsCnt = eventsCnt_;
+            }
+
+            bool hasProgress = false;
+            // NOTE: The downstream stages go first, they free the memory the upstream ones wait for
+            for (size_t i = stages_.size(); i-- > 0 && !hasProgress;)
+            {
+                if (!tryEnter(i))
+                    continue;
+
+                auto result = StepResult::NoWork;
+                try
+                {
+                    result = stages_[i].stage.step();
+                }
+                catch (...)
+                {
+                    leave(i, StepResult::NoWork);
+                    throw;
+                }
+                leave(i, result);
+                hasProgress = result == StepResult::Progress;
+            }
+
+            if (!hasProgress && tryPark(eventsCnt))
+                return;
+        }
+    }
+    catch (...)
+    {
+        isAborted_.store(true);
+        stopWorker(std::current_exception());
+        return;
+    }
+    stopWorker(nullptr);
+}
+
+bool StageScheduler::tryEnter(size_t stageIdx)
+{
+    std::lock_guard<std::mutex> lk(mut_);
+    auto& state = stages_[stageIdx];
+    if (state.isFinishing || state.busyWorkers >= state.stage.maxWorkers)
+        return false;
+
+    size_t busyWorkers = 0;
+    for (size_t i = 0; i < stageIdx; i++)
+        busyWorkers += stages_[i].busyWorkers;
+    size_t reservedWorkers = 0;
+    for (size_t i = stageIdx + 1; i < stages_.size(); i++)
+    {
+        if (!stages_[i].isFinishing)
+            reservedWorkers++;
+    }
+    // NOTE: The worker counts for the stages below as well, so the limit is checked for each of
+    // them. Otherwise an upstream step may take the worker the stages below have left for the last
+    // one
+    for (size_t i = stageIdx; i < stages_.size(); i++)
+    {
+        busyWorkers += stages_[i].busyWorkers;
+        if (busyWorkers + reservedWorkers >= workersCount_)
+            return false;
+        if (i + 1 < stages_.size() && !stages_[i + 1].isFinishing)
+            reservedWorkers--;
+    }
+
+    state.busyWorkers++;
+    return true;
+}
+
+void StageScheduler::leave(size_t stageIdx, StepResult result)
+{
+    std::function<void()> onFinished;
+    bool hasFinished = false;
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        auto& state = stages_[stageIdx];
+        state.busyWorkers--;
+        state.isFinishing = state.isFinishing || result == StepResult::Finished;
+        if (state.isFinishing && state.busyWorkers == 0 && !state.isFinished)
+        {
+            state.isFinished = true;
+            onFinished = state.stage.onFinished;
+            hasFinished = true;
+        }
+    }
+
+    if (hasFinished)
+    {
+        if (onFinished)
+            onFinished();
+        {
+            std::lock_guard<std::mutex> lk(mut_);
+            finishedStagesCnt_++;
+        }
+        // NOTE: The stages above get the worker kept for this one
+        wakeUp(workersCount_);
+    }
+    else if (result == StepResult::Progress)
+    {
+        wakeUp(1);
+    }
+}
+
+bool StageScheduler::tryPark(size_t eventsCnt)
+{
+    std::lock_guard<std::mutex> lk(mut_);
+    if (eventsCnt_ != eventsCnt || isStopping())
+        return false;
+    if (runningWorkersCnt_ == 1)
+    {
+        // NOTE: The worker stays running, so the scheduler isn't done and a wake-up is pending.
+        // The handler is called when the timer is cancelled by wakeUp() as well
+        isPolling_ = true;
+        pollTimer_->expires_after(PollPeriod);
+        pollTimer_->async_wait([this](const boost::system::error_code&) { work(); });
+        return true;
+    }
+    runningWorkersCnt_--;
+    parkedWorkersCnt_++;
+    return true;
+}
+
+void StageScheduler::wakeUp(size_t workersCnt)
+{
+    size_t wokenWorkersCnt = 0;
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        eventsCnt_++;
+        if (isPolling_)
+        {
+            isPolling_ = false;
+            pollTimer_->cancel();
+        }
+        if (isDone_ || isStopping())
+            return;
+        wokenWorkersCnt = std::min(workersCnt, parkedWorkersCnt_);
+        parkedWorkersCnt_ -= wokenWorkersCnt;
+        runningWorkersCnt_ += wokenWorkersCnt;
+    }
+    while (wokenWorkersCnt--)
+        post();
+}
+
+void StageScheduler::post()
+{
+    boost::asio::post(*pool_, [this]() { work(); });
+}
+
+void StageScheduler::stopWorker(std::exception_ptr exception)
+{
+    std::vector<std::function<void()>> onAbortCallbacks;
+    {
+        std::lock_guard<std::mutex> lk(mut_);
+        if (exception && !exception_)
+            exception_ = exception;
+        // NOTE: The parked workers aren't woken up when the scheduler stops, so it's done when the
+        // last running worker stops
+        if (--runningWorkersCnt_ != 0 || isDone_)
+            return;
+        isDone_ = true;
+        // NOTE: No handler is pending, the polling worker is a running one
+        isPolling_ = false;
+        pollTimer_.reset();
+        if (isAborted_.load())
+        {
+            for (const auto& state : stages_)
+            {
+                if (state.stage.onAbort)
+                    onAbortCallbacks.push_back(state.stage.onAbort);
+            }
+        }
+    }
+    for (const auto& onAbort : onAbortCallbacks)
+        onAbort();
+    done_.set_value();
+}
+
+bool StageScheduler::isStopping() const
+{
+    return isAborted_.load() || finishedStagesCnt_ == stages_.size();
+}
+
+PoolThreadsReservation::PoolThreadsReservation(const boost::asio::thread_pool& pool,
+                                               size_t workersCnt)
+    : pool_(&pool)
+    , workersCnt_(workersCnt)
+{
+}
+
+PoolThreadsReservation::PoolThreadsReservation(PoolThreadsReservation&& other) noexcept
+    : pool_(other.pool_)
+    , workersCnt_(other.workersCnt_)
+{
+    other.pool_ = nullptr;
+}
+
+PoolThreadsReservation::~PoolThreadsReservation()
+{
+    if (!pool_)
+        return;
+
+    std::lock_guard<std::mutex> lk(poolsMut);
+    const auto it = reservedPoolThreads.find(pool_);
+    assert(it != reservedPoolThreads.end() && it->second >= workersCnt_);
+    it->second -= workersCnt_;
+    if (it->second == 0)
+        reservedPoolThreads.erase(it);
+}
+
+std::optional<PoolThreadsReservation> PoolThreadsReservation::tryReserve(
+    const boost::asio::thread_pool& pool, size_t poolThreadsCnt, size_t workersCnt)
+{
+    assert(workersCnt != 0);
+    std::lock_guard<std::mutex> lk(poolsMut);
+    auto& reservedThreads = reservedPoolThreads[&pool];
+    if (reservedThreads + workersCnt > poolThreadsCnt)
+    {
+        if (reservedThreads == 0)
+            reservedPoolThreads.erase(&pool);
+        return std::nullopt;
+    }
+    reservedThreads += workersCnt;
+    return PoolThreadsReservation(pool, workersCnt);
+}
+} // namespace Parallel
@@ -0,0 +1,150 @@
+#pragma once
+
+#include <boost/asio/steady_timer.hpp>
+#include <boost/asio/thread_pool.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <exception>
+#include <functional>
+#include <future>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <vector>
+
+namespace Parallel
+{
+enum class StepResult
+{
+    Progress,
+    NoWork,
+    // NOTE: The stage has nothing left to do, e.g. its input queue is closed and empty
+    Finished
+};
+
+// NOTE: Runs the stages of a pipeline on a fixed set of workers. A frame waiting in the queue of a
+// stage is a task of it: an idle worker takes the most downstream stage which has work, so the
+// threads follow the work instead of being split between the stages in advance.
+// A step may wait for the stages below it, e.g. for a memory budget or for place in a queue. So
+// every unfinished stage keeps a worker for itself: with N of them below, a stage and the ones
+// above it never take more than workersCount - N workers together, which makes the order of the
+// stages the only thing needed to avoid a deadlock.
+// A worker with nothing to do is parked: it gives its thread back to the pool and is posted again
+// when a step makes progress, a stage finishes or notify() is called. A step which waits for
+// something, e.g. for memory, may return NoWork instead of blocking, so it's resumed by another
+// post later. The last running worker isn't parked, it polls the stages every PollPeriod on a
+// timer, which doesn't hold a thread either. So a wake-up nobody has sent, e.g. memory released by
+// another scheduler without notify(), only delays the work rather than hangs it. Several
+// schedulers may share a pool, but it needs a thread for every worker whose step may block, see
+// PoolThreadsReservation
+class StageScheduler
+{
+public:
+    static constexpr size_t UnlimitedWorkers = std::numeric_limits<size_t>::max();
+    static constexpr std::chrono::milliseconds PollPeriod{1};
+
+    struct Stage
+    {
+        // NOTE: Does a piece of work of the stage, e.g. reads or hashes a frame
+        std::function<StepResult()> step;
+        // NOTE: E.g. a single writer for a file or a few readers for a hard disk
+        size_t maxWorkers = UnlimitedWorkers;
+        // NOTE: Called once, when the stage has finished and none of the workers runs it, e.g. to
+        // close the queue it fills
+        std::function<void()> onFinished = nullptr;
+        // NOTE: Called when a step has failed and all the workers have stopped, e.g. to drop the
+        // frames of the queue the stage drains, so the stages of other schedulers don't wait for
+        // their memory
+        std::function<void()> onAbort = nullptr;
+    };
+
+public:
+    explicit StageScheduler(size_t workersCount, std::vector<unsigned> cpus = {});
+
+    // NOTE: The stages are added from the upstream to the downstream one. Returns the index of the
+    // stage
+    size_t addStage(Stage stage);
+    // NOTE: May be called while the stages run, e.g. by a step which tunes the number of workers of
+    // its stage. The workers which are already in the stage finish their steps
+    void setMaxWorkers(size_t stageIdx, size_t maxWorkers);
+    void run(boost::asio::thread_pool& pool);
+    // NOTE: Wakes the parked workers, e.g. when another scheduler has released the memory or
+    // closed the queue the stages wait for
+    void notify();
+    // NOTE: Waits until all the stages have finished or a step has failed and the workers have
+    // stopped, then rethrows the first exception
+    void joinAndRethrowExceptions();
+
+    size_t workersCount() const noexcept;
+
+private:
+    struct StageState
+    {
+        Stage stage;
+        size_t busyWorkers = 0;
+        bool isFinishing = false;
+        bool isFinished = false;
+    };
+
+    void work();
+    // NOTE: Returns false if the stage is finished or takes all the workers it may
+    bool tryEnter(size_t stageIdx);
+    void leave(size_t stageIdx, StepResult result);
+    // NOTE: Returns false if something has happened since the worker has looked at the stages.
+    // The last running worker is posted again by the poll timer rather than parked
+    bool tryPark(size_t eventsCnt);
+    // NOTE: Counts an event and posts up to workersCnt parked workers
+    void wakeUp(size_t workersCnt);
+    void post();
+    void stopWorker(std::exception_ptr exception);
+    bool isStopping() const;
+
+private:
+    const size_t workersCount_;
+    const std::vector<unsigned> cpus_;
+    boost::asio::thread_pool* pool_ = nullptr;
+    // NOTE: Exists while the scheduler runs. It's used under the lock only
+    std::optional<boost::asio::steady_timer> pollTimer_;
+    bool isPolling_ = false;
+
+    std::mutex mut_;
+    std::vector<StageState> stages_;
+    size_t finishedStagesCnt_ = 0;
+    size_t runningWorkersCnt_ = 0;
+    size_t parkedWorkersCnt_ = 0;
+    // NOTE: Changes on every step which made progress or finished a stage and on notify()
+    size_t eventsCnt_ = 0;
+    bool isDone_ = false;
+
+    std::atomic<bool> isAborted_ = false;
+    std::exception_ptr exception_;
+    std::promise<void> done_;
+    std::future<void> doneFuture_ = done_.get_future();
+};
+
+// NOTE: Threads of a pool shared by several jobs which are kept for the workers of one of them. A
+// step may block its thread on a full queue or on the I/O, so the workers of all the jobs run on a
+// pool must fit into its threads. Otherwise the blocked workers of some jobs may take all the
+// threads, while the workers they wait for are never run. The threads are given back when the
+// reservation is destroyed
+class PoolThreadsReservation
+{
+public:
+    PoolThreadsReservation(PoolThreadsReservation&& other) noexcept;
+    PoolThreadsReservation& operator=(PoolThreadsReservation&&) = delete;
+    ~PoolThreadsReservation();
+
+    // NOTE: Returns nothing if the threads left in the pool are fewer than the workers
+    static std::optional<PoolThreadsReservation> tryReserve(const boost::asio::thread_pool& pool,
+                                                            size_t poolThreadsCnt,
+                                                            size_t workersCnt);
+
+private:
+    PoolThreadsReservation(const boost::asio::thread_pool& pool, size_t workersCnt);
+
+private:
+    const boost::asio::thread_pool* pool_;
+    size_t workersCnt_;
+};
+} // namespace Parallel
@@ -2,7 +2,10 @@
 
 #include <assert.h>
 #include <atomic>
+#include <exception>
+#include <future>
 #include <memory>
+#include <vector>
 
 template <class T, class U>
 auto makeSharedAtomic(U&& args)
@@ -16,3 +19,25 @@ inline size_t ceilDevision(size_t divisible, size_t divisor)
     auto result = divisible / divisor;
     return (divisible % divisor != 0) ? ++result : result;
 }
+
+// NOTE: Waits for all the tasks, so none of them outlives the data it works with, and rethrows the
+// first exception
+inline void joinAndRethrowFirstException(std::vector<std::future<void>>& futures)
+{
+    std::exception_ptr firstException;
+    for (auto& future : futures)
+    {
+        try
+        {
+            future.get();
+        }
+        catch (...)
+        {
+            if (!firstException)
+                firstException = std::current_exception();
+        }
+    }
+    futures.clear();
+    if (firstException)
+        std::rethrow_exception(firstException);
+}
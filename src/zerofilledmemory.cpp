@@ -2,10 +2,13 @@
 
 #include <cstring>
 
-ZeroFilledMemory::ZeroFilledMemory(size_t n, Parallel::LazyMemoryPoolPtr memoryPool)
+ZeroFilledMemory::ZeroFilledMemory(size_t n,
+                                   Parallel::LazyMemoryPoolPtr memoryPool,
+                                   bool isZeroFilled)
 {
     memory_ = allocate(n, memoryPool.get());
-    memset(memory_, 0, n);
+    if (isZeroFilled)
+        memset(memory_, 0, n);
     memoryPool_ = memoryPool;
     capacity_ = n;
 }
@@ -50,16 +53,18 @@ Parallel::LazyMemoryPoolPtr ZeroFilledMemory::memoryPool() const
 
 unsigned char* ZeroFilledMemory::allocate(size_t n, Parallel::LazyMemoryPool* memoryPool)
 {
-    auto* memory = memoryPool ? memoryPool->allocate(n) : (operator new(n));
+    auto* memory = memoryPool ? memoryPool->allocate(n) : Parallel::allocateAligned(n);
     return static_cast<unsigned char*>(memory);
 }
 
-void ZeroFilledMemory::deallocate(unsigned char* buf, Parallel::LazyMemoryPool* memoryPool)
+void ZeroFilledMemory::deallocate(unsigned char* buf,
+                                  size_t n,
+                                  Parallel::LazyMemoryPool* memoryPool)
 {
-    memoryPool ? memoryPool->deallocate(buf) : operator delete(buf);
+    memoryPool ? memoryPool->deallocate(buf) : Parallel::deallocateAligned(buf, n);
 }
 
 ZeroFilledMemory::~ZeroFilledMemory()
 {
-    deallocate(memory_, memoryPool_.get());
+    deallocate(memory_, capacity_, memoryPool_.get());
 }
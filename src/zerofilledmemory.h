@@ -8,7 +8,11 @@ public:
     ZeroFilledMemory() = default;
     ZeroFilledMemory(const ZeroFilledMemory&) = delete;
 
-    ZeroFilledMemory(size_t n, Parallel::LazyMemoryPoolPtr memoryPool = nullptr);
+    // NOTE: isZeroFilled = false skips the memset. It's for buffers which are overwritten right after
+    // the allocation, the owner is responsible for filling the rest with zeroes
+    ZeroFilledMemory(size_t n,
+                     Parallel::LazyMemoryPoolPtr memoryPool = nullptr,
+                     bool isZeroFilled = true);
     ZeroFilledMemory(ZeroFilledMemory&& other) noexcept;
 
     void swap(ZeroFilledMemory& other) noexcept;
@@ -26,7 +30,7 @@ public:
 
 private:
     static unsigned char* allocate(size_t n, Parallel::LazyMemoryPool* memoryPool);
-    void deallocate(unsigned char* buf, Parallel::LazyMemoryPool* memoryPool);
+    static void deallocate(unsigned char* buf, size_t n, Parallel::LazyMemoryPool* memoryPool);
 
 private:
     unsigned char* memory_ = nullptr;
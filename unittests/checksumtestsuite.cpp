@@ -0,0 +1,125 @@
+#include "checksum.h"
+#include "crc8kernels.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <string>
+
+namespace Test
+{
+namespace
+{
+const std::string CheckInput = "123456789";
+
+ConstDataIterator asData(const std::string& str)
+{
+    return reinterpret_cast<ConstDataIterator>(str.data());
+}
+
+std::vector<unsigned char> calculateWithBlocksKernel(ChecksumAlgorithm algorithm,
+                                                     const std::string& input)
+{
+    const auto& info = checksumInfo(algorithm);
+    std::vector<unsigned char> result(info.digestSize);
+    info.blocksKernel(asData(input), input.size(), 1, result.data());
+    return result;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ChecksumTestSuite)
+BOOST_AUTO_TEST_CASE(CrcEngineCheckValuesTest)
+{
+    // NOTE: check values of the standard CRC catalogue, i.e. CRC of "123456789"
+    BOOST_CHECK_EQUAL((CrcEngine<uint8_t, 0x31, false>::calculate(asData(CheckInput), 9)),
+                      crc8Bytewise({asData(CheckInput), asData(CheckInput) + 9}));
+    BOOST_CHECK_EQUAL((CrcEngine<uint16_t, 0x8005, true>::calculate(asData(CheckInput), 9)),
+                      0xBB3D);
+    BOOST_CHECK_EQUAL((CrcEngine<uint16_t, 0x1021, false, 0xFFFF>::calculate(asData(CheckInput), 9)),
+                      0x29B1);
+    BOOST_CHECK_EQUAL(
+        (CrcEngine<uint32_t, 0x04C11DB7, true, 0xFFFFFFFF, 0xFFFFFFFF>::calculate(
+            asData(CheckInput), 9)),
+        0xCBF43926);
+    BOOST_CHECK_EQUAL(
+        (CrcEngine<uint32_t, 0x1EDC6F41, true, 0xFFFFFFFF, 0xFFFFFFFF>::calculate(
+            asData(CheckInput), 9)),
+        0xE3069283);
+    BOOST_CHECK_EQUAL(
+        (CrcEngine<uint64_t, 0x42F0E1EBA9EA3693, true, ~uint64_t{0}, ~uint64_t{0}>::calculate(
+            asData(CheckInput), 9)),
+        0x995DC9BBDF1939FA);
+}
+
+BOOST_AUTO_TEST_CASE(BlocksKernelsWriteBigEndianDigestsTest)
+{
+    using Digest = std::vector<unsigned char>;
+    BOOST_CHECK(calculateWithBlocksKernel(ChecksumAlgorithm::Crc16, CheckInput) ==
+                (Digest{0xBB, 0x3D}));
+    BOOST_CHECK(calculateWithBlocksKernel(ChecksumAlgorithm::Crc32, CheckInput) ==
+                (Digest{0xCB, 0xF4, 0x39, 0x26}));
+    BOOST_CHECK(calculateWithBlocksKernel(ChecksumAlgorithm::Crc32C, CheckInput) ==
+                (Digest{0xE3, 0x06, 0x92, 0x83}));
+    BOOST_CHECK(calculateWithBlocksKernel(ChecksumAlgorithm::Crc64, CheckInput) ==
+                (Digest{0x99, 0x5D, 0xC9, 0xBB, 0xDF, 0x19, 0x39, 0xFA}));
+}
+
+BOOST_AUTO_TEST_CASE(Crc32cHardwareTest)
+{
+    if (!isCrc32cHardwareSupported())
+        return;
+
+    std::string input;
+    for (size_t size = 0; size < 100; size++)
+    {
+        const auto expected =
+            CrcEngine<uint32_t, 0x1EDC6F41, true, 0xFFFFFFFF, 0xFFFFFFFF>::calculate(
+                asData(input), input.size());
+        BOOST_CHECK_EQUAL(crc32cHardware(asData(input), input.size()), expected);
+        input.push_back(static_cast<char>(size * 37));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CrcEngineExtendByZerosTest)
+{
+    using Crc32 = CrcEngine<uint32_t, 0x04C11DB7, true, 0xFFFFFFFF, 0xFFFFFFFF>;
+    using Crc16Ccitt = CrcEngine<uint16_t, 0x1021, false, 0xFFFF>;
+
+    std::string input = CheckInput;
+    for (size_t zerosCount = 0; zerosCount < 300; zerosCount++)
+    {
+        BOOST_CHECK_EQUAL(Crc32::extendByZeros(Crc32::calculate(asData(CheckInput), 9), zerosCount),
+                          Crc32::calculate(asData(input), input.size()));
+        BOOST_CHECK_EQUAL(
+            Crc16Ccitt::extendByZeros(Crc16Ccitt::calculate(asData(CheckInput), 9), zerosCount),
+            Crc16Ccitt::calculate(asData(input), input.size()));
+        input.push_back('\0');
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ZeroPaddedBlockKernelsTest)
+{
+    const size_t blockSize = 1009;
+    for (const auto& info : availableChecksums())
+    {
+        for (size_t dataSize : std::vector<size_t>{0, 1, 9, 500, blockSize})
+        {
+            std::string block(blockSize, '\0');
+            for (size_t i = 0; i < dataSize; i++)
+                block[i] = static_cast<char>(i * 13 + 1);
+
+            std::vector<unsigned char> result(info.digestSize);
+            info.zeroPaddedBlockKernel(asData(block), dataSize, blockSize, result.data());
+            BOOST_CHECK_MESSAGE(result == calculateWithBlocksKernel(info.algorithm, block),
+                                info.name << ", data size " << dataSize);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ChecksumAlgorithmByNameTest)
+{
+    for (const auto& info : availableChecksums())
+        BOOST_CHECK(checksumAlgorithmByName(info.name) == info.algorithm);
+    BOOST_CHECK(!checksumAlgorithmByName("md5"));
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
@@ -0,0 +1,102 @@
+#include "concurentmemorypool.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <future>
+#include <set>
+#include <thread>
+
+using namespace Parallel;
+
+namespace Test
+{
+BOOST_AUTO_TEST_SUITE(ConcurentMemoryPoolTestSuite)
+BOOST_AUTO_TEST_CASE(ReuseDeallocatedChunkTest)
+{
+    LazyMemoryPool pool;
+    auto* chunk = pool.allocate(16);
+    pool.deallocate(chunk);
+    BOOST_CHECK_EQUAL(chunk, pool.allocate(16));
+}
+
+BOOST_AUTO_TEST_CASE(DeallocateInAnotherThreadTest)
+{
+    LazyMemoryPool pool;
+    std::vector<void*> chunks;
+    for (size_t i = 0; i < 100; i++)
+        chunks.push_back(pool.allocate(32));
+
+    // NOTE: The chunks get to this thread through the free list
+    std::thread([&]() {
+        for (auto* chunk : chunks)
+            pool.deallocate(chunk);
+    }).join();
+
+    std::set<void*> reallocated;
+    for (size_t i = 0; i < chunks.size(); i++)
+        reallocated.insert(pool.allocate(32));
+    BOOST_CHECK(reallocated == std::set<void*>(chunks.begin(), chunks.end()));
+}
+
+BOOST_AUTO_TEST_CASE(WaitForBudgetTest, *boost::unit_test::timeout(10))
+{
+    LazyMemoryPool pool(std::make_shared<MemoryBudget>(16));
+    auto* first = pool.allocate(8);
+    pool.allocate(8);
+
+    auto blockedAllocation = std::async(std::launch::async, [&]() { return pool.allocate(8); });
+    BOOST_CHECK(blockedAllocation.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+
+    pool.deallocate(first);
+    BOOST_CHECK(blockedAllocation.get() != nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurentAllocationsWithBudgetTest, *boost::unit_test::timeout(30))
+{
+    const size_t threadsCount = 8;
+    LazyMemoryPool pool(std::make_shared<MemoryBudget>(threadsCount / 2 * 64));
+
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadsCount; i++)
+    {
+        threads.emplace_back([&pool]() {
+            for (size_t j = 0; j < 10'000; j++)
+                pool.deallocate(pool.allocate(64));
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+BOOST_AUTO_TEST_CASE(PoolWithBudgetDoesntAllocateOverBudgetTest)
+{
+    auto budget = std::make_shared<MemoryBudget>(2 * 32);
+    LazyMemoryPool pool(budget);
+    std::set<void*> chunks{pool.allocate(32), pool.allocate(32)};
+    BOOST_CHECK_EQUAL(budget->bytesInUse(), 2 * 32);
+
+    // NOTE: The chunks deallocated in another thread are reused here rather than new ones allocated
+    std::thread([&]() {
+        for (auto* chunk : chunks)
+            pool.deallocate(chunk);
+    }).join();
+    BOOST_CHECK_EQUAL(budget->bytesInUse(), 0);
+
+    std::set<void*> reallocated{pool.allocate(32), pool.allocate(32)};
+    BOOST_CHECK(reallocated == chunks);
+}
+BOOST_AUTO_TEST_CASE(AlignChunksForDirectIoTest)
+{
+    // NOTE: Big chunks may be read into with O_DIRECT, the small ones aren't aligned on purpose
+    LazyMemoryPool pool;
+    auto* chunk = pool.allocate(3 * DirectIoAlignment + 1);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(chunk) % DirectIoAlignment, 0);
+    pool.deallocate(chunk);
+
+    auto* memory = allocateAligned(DirectIoAlignment);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(memory) % DirectIoAlignment, 0);
+    deallocateAligned(memory, DirectIoAlignment);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
@@ -0,0 +1,229 @@
+#include "concurentqueue.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <numeric>
+#include <thread>
+#include <vector>
+
+using namespace Parallel;
+
+namespace Test
+{
+namespace
+{
+// NOTE: Every producer pushes its own numbers, so the consumers can check that each number is
+// popped exactly once. With a bulk size above 1 the numbers are pushed and popped in batches
+template <typename QueueType>
+void testConcurentPushesAndPops(size_t producersCount,
+                                size_t consumersCount,
+                                size_t capacity,
+                                size_t bulkSize = 1)
+{
+    const size_t valuesPerProducer = 20'000;
+    QueueType queue(capacity);
+    std::vector<std::atomic<unsigned>> poppedCounts(producersCount * valuesPerProducer);
+
+    std::vector<std::thread> producers;
+    for (size_t producer = 0; producer < producersCount; producer++)
+    {
+        producers.emplace_back([&, producer]() {
+            std::vector<size_t> values(valuesPerProducer);
+            std::iota(values.begin(), values.end(), producer * valuesPerProducer);
+            for (size_t first = 0; first < values.size(); first += bulkSize)
+            {
+                const auto last = std::min(first + bulkSize, values.size());
+                queue.waitAndPushBulk(values.data() + first, values.data() + last);
+            }
+        });
+    }
+    std::vector<std::thread> consumers;
+    for (size_t consumer = 0; consumer < consumersCount; consumer++)
+    {
+        consumers.emplace_back([&]() {
+            std::vector<size_t> values(bulkSize);
+            size_t count = 0;
+            while ((count = queue.waitAndPopBulk(values.begin(), bulkSize)) != 0)
+            {
+                for (size_t i = 0; i < count; i++)
+                    poppedCounts[values[i]]++;
+            }
+        });
+    }
+    for (auto& producer : producers)
+        producer.join();
+    queue.close();
+    for (auto& consumer : consumers)
+        consumer.join();
+
+    BOOST_CHECK(std::all_of(poppedCounts.begin(), poppedCounts.end(), [](const auto& count) {
+        return count.load() == 1;
+    }));
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ConcurentQueueTestSuite)
+BOOST_AUTO_TEST_CASE(FifoOrderTest)
+{
+    Queue<int> queue(4);
+    BOOST_CHECK_EQUAL(queue.capacity(), 4);
+    for (int i = 0; i < 4; i++)
+        queue.waitAndPush(i);
+
+    int value = 42;
+    BOOST_CHECK(!queue.tryPush(value));
+    BOOST_CHECK_EQUAL(value, 42);
+
+    for (int i = 0; i < 4; i++)
+    {
+        BOOST_REQUIRE(queue.tryPop(value));
+        BOOST_CHECK_EQUAL(value, i);
+    }
+    BOOST_CHECK(!queue.tryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(BulkPushAndPopTest)
+{
+    Queue<int> queue(4);
+    std::vector<int> values = {0, 1, 2, 3, 4, 5};
+
+    // NOTE: Only the elements which fit are pushed, the rest are left for the next try
+    const auto pushedEnd = queue.tryPushBulk(values.begin(), values.end());
+    BOOST_CHECK(pushedEnd == values.begin() + 4);
+
+    std::vector<int> popped(6, -1);
+    BOOST_CHECK_EQUAL(queue.tryPopBulk(popped.begin(), 3), 3);
+    BOOST_CHECK_EQUAL(queue.tryPushBulk(pushedEnd, values.end()) - pushedEnd, 2);
+    BOOST_CHECK_EQUAL(queue.tryPopBulk(popped.begin() + 3, 6), 3);
+    BOOST_CHECK_EQUAL_COLLECTIONS(popped.begin(), popped.end(), values.begin(), values.end());
+    BOOST_CHECK_EQUAL(queue.tryPopBulk(popped.begin(), 6), 0);
+
+    queue.close();
+    BOOST_CHECK(!queue.waitAndPushBulk(values.begin(), values.end()));
+    BOOST_CHECK_EQUAL(queue.waitAndPopBulk(popped.begin(), 6), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CloseTest, *boost::unit_test::timeout(10))
+{
+    Queue<int> queue(4);
+    queue.waitAndPush(1);
+    queue.waitAndPush(2);
+    queue.close();
+    BOOST_CHECK(queue.isClosed());
+
+    // NOTE: The elements pushed before closing are still popped
+    int value = 0;
+    BOOST_CHECK(!queue.waitAndPush(3));
+    BOOST_REQUIRE(queue.waitAndPop(value));
+    BOOST_CHECK_EQUAL(value, 1);
+    BOOST_REQUIRE(queue.waitAndPop(value));
+    BOOST_CHECK_EQUAL(value, 2);
+    BOOST_CHECK(!queue.waitAndPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(CloseWakesUpWaitersTest, *boost::unit_test::timeout(10))
+{
+    Queue<int> emptyQueue(2);
+    auto blockedPop = std::async(std::launch::async, [&]() {
+        int value = 0;
+        return emptyQueue.waitAndPop(value);
+    });
+    BOOST_CHECK(blockedPop.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+    emptyQueue.close();
+    BOOST_CHECK(!blockedPop.get());
+
+    Queue<int> fullQueue(2);
+    fullQueue.waitAndPush(1);
+    fullQueue.waitAndPush(2);
+    auto blockedPush = std::async(std::launch::async, [&]() { return fullQueue.waitAndPush(3); });
+    BOOST_CHECK(blockedPush.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+    fullQueue.abort();
+    BOOST_CHECK(!blockedPush.get());
+
+    int value = 0;
+    BOOST_CHECK(!fullQueue.tryPop(value));
+}
+
+BOOST_AUTO_TEST_CASE(CapacityIsPowerOfTwoTest)
+{
+    BOOST_CHECK_EQUAL(Queue<int>(5).capacity(), 8);
+    BOOST_CHECK_EQUAL(Queue<int>(1).capacity(), 2);
+    BOOST_CHECK_EQUAL(Queue<int>().capacity(), Queue<int>::DefaultCapacity);
+}
+
+BOOST_AUTO_TEST_CASE(MoveOnlyElementsTest)
+{
+    // NOTE: Elements left in the queue are destroyed with it
+    auto shared = std::make_shared<int>(7);
+    std::unique_ptr<std::shared_ptr<int>> value;
+    {
+        Queue<std::unique_ptr<std::shared_ptr<int>>> queue(2);
+        queue.waitAndPush(std::make_unique<std::shared_ptr<int>>(shared));
+        queue.waitAndPush(std::make_unique<std::shared_ptr<int>>(shared));
+        BOOST_CHECK_EQUAL(shared.use_count(), 3);
+
+        BOOST_REQUIRE(queue.tryPop(value));
+        BOOST_CHECK_EQUAL(**value, 7);
+    }
+    BOOST_CHECK_EQUAL(shared.use_count(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(WaitForPlaceAndForElementTest, *boost::unit_test::timeout(10))
+{
+    Queue<int> queue(2);
+    queue.waitAndPush(1);
+    queue.waitAndPush(2);
+
+    auto blockedPush = std::async(std::launch::async, [&]() { queue.waitAndPush(3); });
+    BOOST_CHECK(blockedPush.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+
+    int value = 0;
+    BOOST_REQUIRE(queue.tryPop(value));
+    blockedPush.get();
+
+    BOOST_REQUIRE(queue.tryPop(value));
+    BOOST_REQUIRE(queue.tryPop(value));
+    BOOST_CHECK_EQUAL(value, 3);
+
+    auto blockedPop = std::async(std::launch::async, [&]() {
+        int popped = 0;
+        return queue.waitAndPop(popped) ? popped : -1;
+    });
+    BOOST_CHECK(blockedPop.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+    queue.waitAndPush(4);
+    BOOST_CHECK_EQUAL(blockedPop.get(), 4);
+}
+
+BOOST_AUTO_TEST_CASE(MpmcTest, *boost::unit_test::timeout(60))
+{
+    testConcurentPushesAndPops<Queue<size_t>>(4, 4, 8);
+}
+
+BOOST_AUTO_TEST_CASE(MpscTest, *boost::unit_test::timeout(60))
+{
+    testConcurentPushesAndPops<MpscQueue<size_t>>(4, 1, 8);
+}
+
+BOOST_AUTO_TEST_CASE(SpscTest, *boost::unit_test::timeout(60))
+{
+    testConcurentPushesAndPops<SpscQueue<size_t>>(1, 1, 4);
+}
+
+BOOST_AUTO_TEST_CASE(BulkMpmcTest, *boost::unit_test::timeout(60))
+{
+    testConcurentPushesAndPops<Queue<size_t>>(4, 4, 16, 5);
+}
+
+BOOST_AUTO_TEST_CASE(BulkSpscTest, *boost::unit_test::timeout(60))
+{
+    testConcurentPushesAndPops<SpscQueue<size_t>>(1, 1, 8, 3);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
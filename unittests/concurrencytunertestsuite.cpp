@@ -0,0 +1,99 @@
+#include "concurrencytuner.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <functional>
+
+using namespace Parallel;
+using namespace std::chrono_literals;
+
+namespace Test
+{
+namespace
+{
+constexpr auto Window = 100ms;
+
+// NOTE: Feeds the tuner with a window of work per call, the work done depends on the concurrency
+// only, and returns the concurrencies the tuner has chosen
+std::vector<size_t> runWindows(ConcurrencyTuner& tuner,
+                               size_t windowsCount,
+                               const std::function<size_t(size_t)>& workOfConcurrency,
+                               double occupancy = 0)
+{
+    std::vector<size_t> concurrencies;
+    auto now = ConcurrencyTuner::Clock::time_point();
+    for (size_t i = 0; i < windowsCount; i++)
+    {
+        now += Window;
+        tuner.onProgress(workOfConcurrency(tuner.concurrency()), occupancy, now);
+        concurrencies.push_back(tuner.concurrency());
+    }
+    return concurrencies;
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(ConcurrencyTunerTestSuite)
+BOOST_AUTO_TEST_CASE(ConvergeToOptimumTest)
+{
+    // NOTE: Up to 5 workers speed the stage up, the rest slow it down by contention
+    const auto workOfConcurrency = [](size_t concurrency) -> size_t {
+        return concurrency <= 5 ? concurrency * 100 : 500 - (concurrency - 5) * 25;
+    };
+    for (size_t initialConcurrency : std::initializer_list<size_t>{1, 16})
+    {
+        ConcurrencyTuner tuner({.maxConcurrency = 16, .initialConcurrency = initialConcurrency},
+                               ConcurrencyTuner::Clock::time_point());
+        const auto concurrencies = runWindows(tuner, 50, workOfConcurrency);
+        for (size_t i = 30; i < concurrencies.size(); i++)
+            BOOST_CHECK(concurrencies[i] >= 4 && concurrencies[i] <= 6);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(StayWithinBoundsTest)
+{
+    ConcurrencyTuner tuner({.minConcurrency = 2, .maxConcurrency = 4, .initialConcurrency = 8},
+                           ConcurrencyTuner::Clock::time_point());
+    BOOST_CHECK_EQUAL(tuner.concurrency(), 4);
+
+    // NOTE: Every worker added speeds the stage up
+    for (const auto concurrency : runWindows(tuner, 20, [](size_t c) { return c * 100; }))
+        BOOST_CHECK(concurrency >= 2 && concurrency <= 4);
+    BOOST_CHECK_GE(tuner.concurrency(), 3);
+}
+
+BOOST_AUTO_TEST_CASE(HoldWithinNoiseTest)
+{
+    // NOTE: The throughput doesn't depend on the workers and jitters by 2%, so after the first
+    // step the number of workers isn't moved
+    ConcurrencyTuner tuner({.maxConcurrency = 8, .initialConcurrency = 4},
+                           ConcurrencyTuner::Clock::time_point());
+    size_t windowsCnt = 0;
+    const auto concurrencies =
+        runWindows(tuner, 30, [&](size_t) -> size_t { return windowsCnt++ % 2 ? 1020 : 1000; });
+    for (const auto concurrency : concurrencies)
+        BOOST_CHECK_EQUAL(concurrency, 5);
+}
+
+BOOST_AUTO_TEST_CASE(FullBudgetBelowTest)
+{
+    // NOTE: The stage below can't keep up, so the workers are given back to it whatever the
+    // throughput is
+    ConcurrencyTuner tuner({.maxConcurrency = 8, .initialConcurrency = 8},
+                           ConcurrencyTuner::Clock::time_point());
+    runWindows(tuner, 10, [](size_t c) { return c * 100; }, 0.95);
+    BOOST_CHECK_EQUAL(tuner.concurrency(), 1);
+}
+
+BOOST_AUTO_TEST_CASE(WaitForWindowTest)
+{
+    const auto begin = ConcurrencyTuner::Clock::time_point();
+    ConcurrencyTuner tuner({.maxConcurrency = 8, .initialConcurrency = 1, .window = Window},
+                           begin);
+    BOOST_CHECK(!tuner.onProgress(100, 0, begin + Window / 2));
+    const auto concurrency = tuner.onProgress(100, 0, begin + Window);
+    BOOST_REQUIRE(concurrency);
+    BOOST_CHECK_EQUAL(*concurrency, 2);
+    BOOST_CHECK_EQUAL(tuner.concurrency(), 2);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
@@ -0,0 +1,124 @@
+#include "crc8kernels.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+
+namespace Test
+{
+namespace
+{
+std::vector<unsigned char> getRandomData(size_t size)
+{
+    std::mt19937 generator(static_cast<unsigned int>(size));
+    std::uniform_int_distribution<unsigned int> distribution(0, 255);
+    std::vector<unsigned char> result(size);
+    for (auto& byte : result)
+        byte = static_cast<unsigned char>(distribution(generator));
+    return result;
+}
+
+ConstDataRange asRange(const std::vector<unsigned char>& data)
+{
+    return {data.data(), data.data() + data.size()};
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(Crc8KernelsTestSuite)
+BOOST_AUTO_TEST_CASE(AllKernelsAreEqualToReferenceTest)
+{
+    const std::vector<size_t> sizes{0, 1, 7, 8, 9, 15, 16, 17, 63, 64, 65, 255, 1000, 4096, 65537};
+    for (const auto size : sizes)
+    {
+        const auto data = getRandomData(size);
+        const auto expected = crc8Bytewise(asRange(data));
+        for (const auto& info : availableCrc8Kernels())
+            BOOST_CHECK_MESSAGE(info.kernel(asRange(data), 0) == expected,
+                                info.name << " failed on " << size << " bytes");
+    }
+}
+
+BOOST_AUTO_TEST_CASE(KernelsContinueFromGivenCrcTest)
+{
+    const auto data = getRandomData(333);
+    const auto expected = crc8Bytewise(asRange(data));
+    for (const auto& info : availableCrc8Kernels())
+    {
+        const auto head = info.kernel({data.data(), data.data() + 100}, 0);
+        BOOST_CHECK_EQUAL(info.kernel({data.data() + 100, data.data() + data.size()}, head),
+                          expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(InterleavedBlocksTest)
+{
+    for (size_t blockSize : {1u, 3u, 16u, 32u, 64u})
+    {
+        for (size_t blocksCount : {0u, 1u, 7u, 8u, 9u, 100u})
+        {
+            const auto data = getRandomData(blockSize * blocksCount);
+            std::vector<Crc8ResultType> result(blocksCount);
+            crc8InterleavedBlocks(data.data(), blockSize, blocksCount, result.data());
+
+            std::vector<Crc8ResultType> expected;
+            for (size_t i = 0; i < blocksCount; i++)
+            {
+                const auto blockBegin = data.data() + i * blockSize;
+                expected.push_back(crc8Bytewise({blockBegin, blockBegin + blockSize}));
+            }
+            BOOST_CHECK_EQUAL_COLLECTIONS(
+                result.begin(), result.end(), expected.begin(), expected.end());
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(BlocksKernelForBlockSizeTest)
+{
+    const std::vector<size_t> blockSizes{1, 31, 64, 500, 512, 4096, 4097, 65536, 1048576};
+    for (const auto blockSize : blockSizes)
+    {
+        const size_t blocksCount = 3;
+        const auto data = getRandomData(blockSize * blocksCount);
+        std::vector<Crc8ResultType> result(blocksCount);
+        crc8BlocksKernelFor(blockSize)(data.data(), blockSize, blocksCount, result.data());
+
+        for (size_t i = 0; i < blocksCount; i++)
+        {
+            const auto blockBegin = data.data() + i * blockSize;
+            BOOST_CHECK_MESSAGE(result[i] == crc8Bytewise({blockBegin, blockBegin + blockSize}),
+                                "block size " << blockSize << ", block " << i);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CombineTest)
+{
+    const auto data = getRandomData(5000);
+    const auto expected = crc8Bytewise(asRange(data));
+    for (size_t split : {0u, 1u, 17u, 2500u, 4999u, 5000u})
+    {
+        const auto crcA = crc8Bytewise({data.data(), data.data() + split});
+        const auto crcB = crc8Bytewise({data.data() + split, data.data() + data.size()});
+        BOOST_CHECK_EQUAL(crc8Combine(crcA, crcB, data.size() - split), expected);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ClmulKernelIsAvailableOnlyIfSupportedTest)
+{
+    const auto& kernels = availableCrc8Kernels();
+    const auto hasClmul = std::any_of(kernels.begin(), kernels.end(), [](const Crc8KernelInfo& info) {
+        return info.kernel == crc8Clmul;
+    });
+    BOOST_CHECK_EQUAL(hasClmul, isCrc8ClmulSupported());
+}
+
+BOOST_AUTO_TEST_CASE(FastestKernelIsOneOfAvailableTest)
+{
+    const auto& fastest = fastestCrc8Kernel();
+    const auto& kernels = availableCrc8Kernels();
+    BOOST_VERIFY(std::any_of(kernels.begin(), kernels.end(), [&](const Crc8KernelInfo& info) {
+        return info.kernel == fastest.kernel;
+    }));
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
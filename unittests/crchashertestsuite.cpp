@@ -1,9 +1,12 @@
 #include "crchasher.h"
+#include "memorysizeliterals.h"
 #include "testtools.h"
 #include "utils.h"
 
+#include <boost/asio/post.hpp>
 #include <boost/test/unit_test.hpp>
 
+#include <future>
 #include <set>
 
 namespace Test
@@ -39,21 +42,19 @@ void testCalculateForWholeQueue(std::vector<DataFrame> inputData,
                                 std::vector<DataFrame> outputData,
                                 size_t threadCnt)
 {
-    Parallel::Queue<DataFrame> outputQueue;
-    auto hasProducerFinished = makeSharedAtomic<bool>(false);
+    Parallel::MpscQueue<DataFrame> outputQueue;
     boost::asio::thread_pool pool(threadCnt);
 
     Parallel::Queue<DataFrame> inputQueue;
     for (auto& inDataFrame : inputData)
         inputQueue.waitAndPush(inDataFrame);
+    inputQueue.close();
 
     Parallel::Crc8Wrapper crchasher;
     crchasher.calculateForWholeQueue({.src = inputQueue,
                                       .dest = outputQueue,
-                                      .hasProducerFinished = hasProducerFinished,
                                       .tasksCount = threadCnt,
                                       .pool = pool});
-    hasProducerFinished->store(true);
     crchasher.joinAndRethrowExceptions();
 
     std::set<DataFrame> result;
@@ -125,11 +126,202 @@ BOOST_AUTO_TEST_CASE(CalculatateFrameCrc)
     BOOST_CHECK_EQUAL(calculateCrc8OfFrame(inputFrame, getPool()), expectedFrame);
 }
 
+BOOST_AUTO_TEST_CASE(OutputFrameCapacityFollowsInputFrameCapacity)
+{
+    // NOTE: A short last frame must fit the same chunks of the output memory pool as others
+    auto inputFrame = createDataFrameWithData(3, {{0x7B, 0x00}, {0x32, 0x7B}, {0x02, 0x70}});
+    inputFrame.setBlocksCount(1);
+    for (const auto& info : availableChecksums())
+    {
+        const auto outFrame = calculateChecksumOfFrame(
+            inputFrame, std::make_shared<Parallel::LazyMemoryPool>(), info.blocksKernel, info);
+        BOOST_CHECK_EQUAL(outFrame.blocksCount(), 1);
+        BOOST_CHECK_EQUAL(outFrame.capacity(), 3 * info.digestSize);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CalculateFrameCrcWithPadding)
+{
+    auto getPool = std::make_shared<Parallel::LazyMemoryPool>;
+
+    // NOTE: The padding isn't read, so garbage in it mustn't change the result
+    auto inputFrame = createDataFrameWithData(4, {{0x02, 0xFF, 0x3A}, {0xDE, 0xFF, 0xFF}});
+    inputFrame.setPaddingSize(2);
+    auto zeroPaddedFrame = createDataFrameWithData(4, {{0x02, 0xFF, 0x3A}, {0xDE, 0x00, 0x00}});
+    BOOST_CHECK_EQUAL(calculateCrc8OfFrame(inputFrame, getPool()),
+                      calculateCrc8OfFrame(zeroPaddedFrame, getPool()));
+
+    for (const auto& info : availableChecksums())
+    {
+        BOOST_CHECK_EQUAL(
+            calculateChecksumOfFrame(inputFrame, getPool(), info.blocksKernel, info),
+            calculateChecksumOfFrame(zeroPaddedFrame, getPool(), info.blocksKernel, info));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CalculateFrameCrcWithHoles)
+{
+    auto getPool = std::make_shared<Parallel::LazyMemoryPool>;
+
+    // NOTE: Hole blocks aren't read, so garbage in them mustn't change the result
+    auto inputFrame = createDataFrameWithData(
+        7, {{0xFF, 0xFF}, {0x02, 0xFF}, {0xFF, 0xFF}, {0xFF, 0xFF}, {0x3A, 0xAB}, {0xFF, 0xFF}});
+    inputFrame.setHoles({{0, 1}, {2, 4}, {5, 6}});
+    auto zeroFilledFrame = createDataFrameWithData(
+        7, {{0x00, 0x00}, {0x02, 0xFF}, {0x00, 0x00}, {0x00, 0x00}, {0x3A, 0xAB}, {0x00, 0x00}});
+
+    for (const auto& info : availableChecksums())
+    {
+        BOOST_CHECK_EQUAL(
+            calculateChecksumOfFrame(inputFrame, getPool(), info.blocksKernel, info),
+            calculateChecksumOfFrame(zeroFilledFrame, getPool(), info.blocksKernel, info));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(CalculateChecksumOfFrameSlices)
+{
+    auto getPool = std::make_shared<Parallel::LazyMemoryPool>;
+
+    auto inputFrame = createDataFrameWithData(
+        3, {{0x11, 0x22}, {0x00, 0x00}, {0x33, 0x44}, {0x55, 0x66}, {0x77, 0x00}});
+    inputFrame.setHoles({{1, 2}});
+    inputFrame.setPaddingSize(1);
+
+    for (const auto& info : availableChecksums())
+    {
+        const auto whole = calculateChecksumOfFrame(inputFrame, getPool(), info.blocksKernel, info);
+
+        // NOTE: Every slice is hashed without copying and gives its part of the whole digests
+        const auto shared = DataFrame(inputFrame).share();
+        std::vector<unsigned char> slicesDigests;
+        const std::vector<std::pair<size_t, size_t>> slices = {{0, 2}, {2, 1}, {3, 2}};
+        for (const auto& [firstBlock, blocksCount] : slices)
+        {
+            const auto slice = shared.slice(firstBlock, blocksCount);
+            const auto digests =
+                calculateChecksumOfFrame(slice, getPool(), info.blocksKernel, info);
+            BOOST_CHECK_EQUAL(digests.firstBlockIndex(), 3 + firstBlock);
+            slicesDigests.insert(slicesDigests.end(), digests.cbegin(), digests.cend());
+        }
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            slicesDigests.begin(), slicesDigests.end(), whole.cbegin(), whole.cend());
+    }
+}
+
 BOOST_AUTO_TEST_CASE(CalculateForWholeQueue)
 {
     testCalculateForWholeQueue({}, {}, 1);
     testCalculateForWholeQueue(getDefaultCrcInputData(), getDefaultExpectedCrcOutputData(), 1);
     testCalculateForWholeQueue(getDefaultCrcInputData(), getDefaultExpectedCrcOutputData(), 5);
 }
+
+BOOST_AUTO_TEST_CASE(CalculateForWholeQueueStopsWhenConsumerIsGone, *boost::unit_test::timeout(10))
+{
+    // NOTE: The output queue is closed as if the writer failed, the calculation must not hang on
+    // the full input queue
+    boost::asio::thread_pool pool(2);
+    Parallel::Queue<DataFrame> inputQueue(4);
+    Parallel::MpscQueue<DataFrame> outputQueue(2);
+    outputQueue.close();
+
+    Parallel::Crc8Wrapper crchasher;
+    crchasher.calculateForWholeQueue(
+        {.src = inputQueue, .dest = outputQueue, .tasksCount = 2, .pool = pool});
+    for (const auto& frame : getDefaultCrcInputData())
+        inputQueue.waitAndPush(frame);
+    crchasher.joinAndRethrowExceptions();
+
+    DataFrame frame;
+    BOOST_CHECK(inputQueue.isClosed());
+    BOOST_CHECK(!outputQueue.tryPop(frame));
+}
+
+BOOST_AUTO_TEST_CASE(BatchSizeFollowsBudgetTest)
+{
+    using Parallel::Crc8Wrapper;
+    BOOST_CHECK_EQUAL(Crc8Wrapper::batchSizeFor(1000, 4), Crc8Wrapper::DefaultBatchSize);
+    // NOTE: When a few frames fit into the budget, a task doesn't take them all
+    BOOST_CHECK_EQUAL(Crc8Wrapper::batchSizeFor(8, 2), 2);
+    BOOST_CHECK_EQUAL(Crc8Wrapper::batchSizeFor(4, 4), 1);
+    BOOST_CHECK_EQUAL(Crc8Wrapper::batchSizeFor(1, 0), 1);
+}
+
+BOOST_AUTO_TEST_CASE(CalculateSplittedRangeCrc)
+{
+    std::vector<unsigned char> input(100'003);
+    for (size_t i = 0; i < input.size(); i++)
+        input[i] = static_cast<unsigned char>(i * 7 + i / 251);
+    const ConstDataRange range{input.data(), input.data() + input.size()};
+
+    boost::asio::thread_pool pool(3);
+    for (size_t segmentsCount : {1u, 2u, 3u, 8u, 1000u})
+        BOOST_CHECK_EQUAL(Parallel::crc8(range, segmentsCount, pool), crc8(range));
+
+    const ConstDataRange emptyRange{input.data(), input.data()};
+    BOOST_CHECK_EQUAL(Parallel::crc8(emptyRange, 4, pool), 0);
+}
+
+BOOST_AUTO_TEST_CASE(CalculateSplittedRangeCrcWhenPoolIsBusy, *boost::unit_test::timeout(10))
+{
+    std::vector<unsigned char> input(4096, 0xA5);
+    const ConstDataRange range{input.data(), input.data() + input.size()};
+
+    // NOTE: The only pool thread is blocked, so the calling thread has to hash all the segments
+    boost::asio::thread_pool pool(1);
+    std::promise<void> unblock;
+    post(pool, [future = unblock.get_future()]() { future.wait(); });
+
+    BOOST_CHECK_EQUAL(Parallel::crc8(range, 4, pool), crc8(range));
+    unblock.set_value();
+    pool.join();
+}
+
+BOOST_AUTO_TEST_CASE(CalculateForWholeQueueWithHugeBlock)
+{
+    const size_t blockSize = 9 * MB;
+    DataFrame inFrame({.firstBlockIdx = 3, .blockSize = blockSize, .blocksCount = 2});
+    for (size_t i = 0; i < inFrame.totalSizeOfAllBlocks(); i++)
+        inFrame.begin()[i] = static_cast<unsigned char>(i ^ (i >> 9));
+
+    DataFrame expected({.firstBlockIdx = 3, .blockSize = sizeof(Crc8ResultType), .blocksCount = 2});
+    for (size_t i = 0; i < inFrame.blocksCount(); i++)
+        *expected.blockAsRange(i).begin() = crc8(inFrame.blockAsRange(i));
+
+    testCalculateForWholeQueue({inFrame}, {expected}, 2);
+
+    const size_t paddingSize = 3 * MB + 5;
+    std::fill(inFrame.end() - paddingSize, inFrame.end(), 0);
+    *expected.blockAsRange(1).begin() = crc8(inFrame.blockAsRange(1));
+    std::fill(inFrame.end() - paddingSize, inFrame.end(), 0xFF);
+    inFrame.setPaddingSize(paddingSize);
+    testCalculateForWholeQueue({inFrame}, {expected}, 2);
+}
+
+BOOST_AUTO_TEST_CASE(CalculateFrameWithHugeBlockOnBusyPool, *boost::unit_test::timeout(30))
+{
+    DataFrame inFrame({.firstBlockIdx = 7, .blockSize = 9 * MB, .blocksCount = 1});
+    for (size_t i = 0; i < inFrame.totalSizeOfAllBlocks(); i++)
+        inFrame.begin()[i] = static_cast<unsigned char>(i ^ (i >> 11));
+
+    // NOTE: The segments are posted to the pool the step runs on. Its only thread is taken, so
+    // the step hashes all of them itself
+    boost::asio::thread_pool pool(1);
+    std::promise<void> unblock;
+    boost::asio::post(pool, [future = unblock.get_future()]() { future.wait(); });
+
+    Parallel::Crc8Wrapper hasher;
+    Parallel::MpscQueue<DataFrame> dest(1);
+    BOOST_CHECK(hasher.calculateFrameAndPush(DataFrameView(inFrame),
+                                             {.dest = dest,
+                                              .checksum = ChecksumAlgorithm::Crc8,
+                                              .outputBudget = nullptr,
+                                              .segmentsPool = &pool}));
+    unblock.set_value();
+    pool.join();
+
+    DataFrame outFrame;
+    BOOST_REQUIRE(dest.tryPop(outFrame));
+    BOOST_CHECK_EQUAL(outFrame, calculateCrc8OfFrame(inFrame, nullptr));
+}
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace Test
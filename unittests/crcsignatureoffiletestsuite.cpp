@@ -4,9 +4,11 @@
 #include <filesystem>
 
 #include "crcsignatureoffile.h"
+#include "datafile.h"
 #include "memorysizeliterals.h"
 #include "testdefs.h"
 #include "testtools.h"
+#include "utils.h"
 
 namespace fs = std::filesystem;
 
@@ -56,7 +58,12 @@ BOOST_AUTO_TEST_CASE(CleanupTest, *boost::unit_test::timeout(2))
     }
 }
 
-void testReadCalculateAndWrite(size_t dataBlockSize, bool isSSD, size_t maxRamSize)
+void testReadCalculateAndWrite(size_t dataBlockSize,
+                               bool isSSD,
+                               size_t maxRamSize,
+                               bool isNumaAware = false,
+                               bool isReadAndHashFused = false,
+                               bool isInputMapped = false)
 {
     assert(!fs::exists(TempTestFileName));
     assert(fs::exists(PermanentTestFileName));
@@ -66,7 +73,10 @@ void testReadCalculateAndWrite(size_t dataBlockSize, bool isSSD, size_t maxRamSi
                                    .outputFile = TempTestFileName,
                                    .blockSize = dataBlockSize,
                                    .isSSD = isSSD,
-                                   .maxRamSize = maxRamSize});
+                                   .maxRamSize = maxRamSize,
+                                   .isNumaAware = isNumaAware,
+                                   .isReadAndHashFused = isReadAndHashFused,
+                                   .isInputMapped = isInputMapped});
     calculater.readCalculateAndWrite();
 
     const auto result = readWholeFile(TempTestFileName);
@@ -89,5 +99,336 @@ BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteTest)
         "program with --help parametr for more information";
     });
 }
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteInNumaModeTest)
+{
+    // NOTE: On single node systems the NUMA mode falls back to the usual one
+    testReadCalculateAndWrite(20, false, 1 * MB, true);
+    testReadCalculateAndWrite(MB, true, 300 * MB, true);
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteOnSeveralSchedulersTest, *boost::unit_test::timeout(60))
+{
+    // NOTE: The nodes are made up, so the schedulers share the budgets and the output queue on any
+    // system. The small budgets fill up, so the stages wait for the ones of the other scheduler
+    const std::vector<Parallel::NumaNode> nodes{{.id = 0, .cpus = {}}, {.id = 1, .cpus = {}}};
+    for (const auto& [dataBlockSize, maxRamSize, isReadAndHashFused] :
+         std::vector<std::tuple<size_t, size_t, bool>>{{20, 1 * MB, false},
+                                                       {12 * KB, 72 * KB, false},
+                                                       {KB, 300 * KB, false},
+                                                       {20, 1 * MB, true},
+                                                       {12 * KB, 72 * KB, true}})
+    {
+        assert(!fs::exists(TempTestFileName));
+        AutoFileRemover remover(TempTestFileName);
+
+        CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                       .outputFile = TempTestFileName,
+                                       .blockSize = dataBlockSize,
+                                       .isSSD = true,
+                                       .maxRamSize = maxRamSize,
+                                       .isNumaAware = true,
+                                       .isReadAndHashFused = isReadAndHashFused,
+                                       .threadsCount = 3 * nodes.size()},
+                                      nullptr,
+                                      nodes);
+        BOOST_CHECK_EQUAL(calculater.schedulers_.size(), 0);
+        calculater.readCalculateAndWrite();
+        BOOST_CHECK_EQUAL(calculater.schedulers_.size(), nodes.size());
+
+        const auto result = readWholeFile(TempTestFileName);
+        const auto expected =
+            simpleCalculateCrcSignatureOfFile(PermanentTestFileName, dataBlockSize);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxReadersOnHardDiskTest)
+{
+    // NOTE: The stream buffers are planned for the readers the tuner may run, a hard disk gets
+    // just a couple of them, so its buffers and frames stay big on a machine of many cores
+    AutoFileRemover remover(TempTestFileName);
+    for (const bool isSSD : {false, true})
+    {
+        CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                       .outputFile = TempTestFileName,
+                                       .blockSize = KB,
+                                       .isSSD = isSSD,
+                                       .maxRamSize = 10 * MB,
+                                       .threadsCount = 16});
+        if (isSSD)
+            BOOST_CHECK_EQUAL(calculater.maxReadersCnt_, 14);
+        else
+            BOOST_CHECK_EQUAL(calculater.maxReadersCnt_, 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteInFusedModeTest)
+{
+    // NOTE: The frames are cut to fit into the CPU cache, so a big file is hashed in many of them
+    testReadCalculateAndWrite(1, true, 1 * MB, false, true);
+    testReadCalculateAndWrite(20, false, 1 * MB, false, true);
+    testReadCalculateAndWrite(12 * KB, true, 36 * KB, false, true);
+    testReadCalculateAndWrite(MB, true, 300 * MB, false, true);
+    testReadCalculateAndWrite(MB, true, 300 * MB, true, true);
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteWithMappedInputTest)
+{
+    // NOTE: The input takes no RAM, so even a block bigger than the limit is hashed
+    testReadCalculateAndWrite(1, true, 1 * MB, false, false, true);
+    testReadCalculateAndWrite(20, false, 1 * MB, false, false, true);
+    testReadCalculateAndWrite(12 * KB, true, 36 * KB, false, false, true);
+    testReadCalculateAndWrite(MB + 7, true, 300 * MB, false, false, true);
+    testReadCalculateAndWrite(3 * MB, true, 1 * MB, true, false, true);
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteWithRingTest)
+{
+    // NOTE: Where io_uring isn't available the input is read with streams
+    const auto test = [](size_t blockSize, size_t maxRamSize, size_t ioQueueDepth) {
+        assert(!fs::exists(TempTestFileName));
+        AutoFileRemover remover(TempTestFileName);
+
+        CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                       .outputFile = TempTestFileName,
+                                       .blockSize = blockSize,
+                                       .isSSD = true,
+                                       .maxRamSize = maxRamSize,
+                                       .ioQueueDepth = ioQueueDepth});
+        calculater.readCalculateAndWrite();
+
+        const auto result = readWholeFile(TempTestFileName);
+        const auto expected = simpleCalculateCrcSignatureOfFile(PermanentTestFileName, blockSize);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    };
+    test(1, 1 * MB, 4);
+    test(20, 1 * MB, 32);
+    test(12 * KB, 36 * KB, 32);
+    test(MB + 7, 300 * MB, 32);
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteWithDirectInputTest)
+{
+    // NOTE: The input fails to open rather than falling back to the page cache, so a passed run
+    // has read the file directly
+    if (!DataFile::canBeReadDirectly(PermanentTestFileName))
+    {
+        BOOST_TEST_MESSAGE("O_DIRECT isn't supported here, the test is skipped");
+        return;
+    }
+
+    const auto makeOptions = [](size_t blockSize, size_t maxRamSize, size_t ioQueueDepth) {
+        return Options{.inputFile = PermanentTestFileName,
+                       .outputFile = TempTestFileName,
+                       .blockSize = blockSize,
+                       .isSSD = true,
+                       .maxRamSize = maxRamSize,
+                       .isInputDirect = true,
+                       .ioQueueDepth = ioQueueDepth};
+    };
+    const auto test = [&](size_t blockSize, size_t maxRamSize, size_t ioQueueDepth) {
+        assert(!fs::exists(TempTestFileName));
+        AutoFileRemover remover(TempTestFileName);
+
+        CrcSignatureOfFile calculater(makeOptions(blockSize, maxRamSize, ioQueueDepth));
+        calculater.readCalculateAndWrite();
+
+        const auto result = readWholeFile(TempTestFileName);
+        const auto expected = simpleCalculateCrcSignatureOfFile(PermanentTestFileName, blockSize);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    };
+    for (const size_t ioQueueDepth : {size_t(0), size_t(8)})
+    {
+        test(1, 1 * MB, ioQueueDepth);
+        test(1000, 16 * MB, ioQueueDepth);
+        test(12 * KB, 100 * KB, ioQueueDepth);
+
+        // NOTE: The blocks which can't be aligned within the frame size limit are rejected rather
+        // than read through the page cache
+        for (const auto& [blockSize, maxRamSize] : {std::pair{size_t(1000), 1 * MB},
+                                                   std::pair{MB + 7, 300 * MB}})
+        {
+            AutoFileRemover remover(TempTestFileName);
+            BOOST_CHECK_THROW(
+                CrcSignatureOfFile(makeOptions(blockSize, maxRamSize, ioQueueDepth)),
+                std::invalid_argument);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteWithFixedThreadsTest)
+{
+    assert(!fs::exists(TempTestFileName));
+    AutoFileRemover remover(TempTestFileName);
+
+    const size_t blockSize = 4 * KB;
+    CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                   .outputFile = TempTestFileName,
+                                   .blockSize = blockSize,
+                                   .isSSD = true,
+                                   .maxRamSize = 10 * MB,
+                                   .threadsCount = 5,
+                                   .readersCount = 3,
+                                   .hashersCount = 1});
+    calculater.readCalculateAndWrite();
+
+    const auto result = readWholeFile(TempTestFileName);
+    const auto expected = simpleCalculateCrcSignatureOfFile(PermanentTestFileName, blockSize);
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteOnSharedPoolTest, *boost::unit_test::timeout(60))
+{
+    // NOTE: The pool has a thread for every worker of both jobs
+    constexpr size_t ThreadsCnt = 4;
+    boost::asio::thread_pool pool(2 * ThreadsCnt);
+    const size_t blockSize = 4 * KB;
+    const std::string outputFiles[2] = {TempTestFileName, std::string(TempTestFileName) + "2"};
+    AutoFileRemover firstRemover(outputFiles[0]);
+    AutoFileRemover secondRemover(outputFiles[1]);
+    std::vector<std::future<void>> jobs;
+    for (const auto& outputFile : outputFiles)
+    {
+        assert(!fs::exists(outputFile));
+        jobs.push_back(std::async(std::launch::async, [&]() {
+            CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                           .outputFile = outputFile,
+                                           .blockSize = blockSize,
+                                           .isSSD = true,
+                                           .maxRamSize = 1 * MB,
+                                           .threadsCount = ThreadsCnt},
+                                          pool,
+                                          2 * ThreadsCnt);
+            calculater.readCalculateAndWrite();
+        }));
+    }
+    joinAndRethrowFirstException(jobs);
+
+    const auto expected = simpleCalculateCrcSignatureOfFile(PermanentTestFileName, blockSize);
+    for (const auto& outputFile : outputFiles)
+    {
+        const auto result = readWholeFile(outputFile);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(TooSmallSharedPoolTest)
+{
+    boost::asio::thread_pool pool(2);
+    BOOST_CHECK_THROW(CrcSignatureOfFile({.inputFile = PermanentTestFileName,
+                                          .outputFile = TempTestFileName,
+                                          .blockSize = 4 * KB,
+                                          .isSSD = true,
+                                          .maxRamSize = 1 * MB,
+                                          .threadsCount = 4},
+                                         pool,
+                                         2),
+                      std::invalid_argument);
+    BOOST_CHECK(!fs::exists(TempTestFileName));
+}
+
+BOOST_AUTO_TEST_CASE(MoreJobsThanSharedPoolThreadsTest, *boost::unit_test::timeout(60))
+{
+    // NOTE: The jobs which don't fit into the threads left by the others are rejected, the rest
+    // are run to the end rather than block each other
+    constexpr size_t PoolThreadsCnt = 4;
+    constexpr size_t JobsCnt = 6;
+    constexpr size_t ThreadsCnt = 3;
+    boost::asio::thread_pool pool(PoolThreadsCnt);
+    const size_t blockSize = 4 * KB;
+    std::vector<std::string> outputFiles;
+    std::deque<AutoFileRemover> removers;
+    for (size_t i = 0; i < JobsCnt; i++)
+    {
+        outputFiles.push_back(std::string(TempTestFileName) + std::to_string(i));
+        assert(!fs::exists(outputFiles.back()));
+        removers.emplace_back(outputFiles.back());
+    }
+
+    std::vector<std::future<bool>> jobs;
+    for (const auto& outputFile : outputFiles)
+    {
+        jobs.push_back(std::async(std::launch::async, [&]() {
+            try
+            {
+                CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                               .outputFile = outputFile,
+                                               .blockSize = blockSize,
+                                               .isSSD = true,
+                                               .maxRamSize = 1 * MB,
+                                               .threadsCount = ThreadsCnt},
+                                              pool,
+                                              PoolThreadsCnt);
+                calculater.readCalculateAndWrite();
+            }
+            catch (const std::invalid_argument&)
+            {
+                return false;
+            }
+            return true;
+        }));
+    }
+
+    const auto expected = simpleCalculateCrcSignatureOfFile(PermanentTestFileName, blockSize);
+    size_t doneJobsCnt = 0;
+    for (size_t i = 0; i < JobsCnt; i++)
+    {
+        if (!jobs[i].get())
+        {
+            BOOST_CHECK(!fs::exists(outputFiles[i]));
+            continue;
+        }
+        doneJobsCnt++;
+        const auto result = readWholeFile(outputFiles[i]);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    }
+    BOOST_CHECK_NE(doneJobsCnt, 0);
+
+    // NOTE: The threads of the finished jobs are given back to the pool
+    const auto& outputFile = outputFiles.front();
+    fs::remove(outputFile);
+    CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                   .outputFile = outputFile,
+                                   .blockSize = blockSize,
+                                   .isSSD = true,
+                                   .maxRamSize = 1 * MB,
+                                   .threadsCount = PoolThreadsCnt},
+                                  pool,
+                                  PoolThreadsCnt);
+    calculater.readCalculateAndWrite();
+    const auto result = readWholeFile(outputFile);
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ReadCalculateAndWriteWithWideChecksumTest)
+{
+    assert(!fs::exists(TempTestFileName));
+    AutoFileRemover remover(TempTestFileName);
+
+    const size_t blockSize = 3 * KB;
+    CrcSignatureOfFile calculater({.inputFile = PermanentTestFileName,
+                                   .outputFile = TempTestFileName,
+                                   .blockSize = blockSize,
+                                   .isSSD = true,
+                                   .maxRamSize = 10 * MB,
+                                   .checksum = ChecksumAlgorithm::Crc32C});
+    calculater.readCalculateAndWrite();
+
+    auto input = readWholeFile(PermanentTestFileName);
+    const auto blocksCount = ceilDevision(input.size(), blockSize);
+    input.resize(blocksCount * blockSize, 0);
+    std::vector<unsigned char> expected(blocksCount * 4);
+    checksumInfo(ChecksumAlgorithm::Crc32C)
+        .blocksKernel(input.data(), blockSize, blocksCount, expected.data());
+
+    const auto result = readWholeFile(TempTestFileName);
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+}
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace Test
@@ -3,6 +3,7 @@
 #include <filesystem>
 
 #include "datafile.h"
+#include "defs.h"
 #include "testdefs.h"
 #include "testtools.h"
 
@@ -88,6 +89,115 @@ BOOST_AUTO_TEST_CASE(ReadDataBlocksAsFrameFromFileWithNonIntegerNumberOfDataBloc
     auto expectedDataFrameWithZeroFilledLastDataBlock =
         createDataFrameWithData(0, {{0x77, 0x22, 0xAB}, {0x01, 0x00, 0x00}});
     BOOST_CHECK_EQUAL(expectedDataFrameWithZeroFilledLastDataBlock, result);
+    BOOST_CHECK_EQUAL(2, result.paddingSize());
+}
+
+BOOST_AUTO_TEST_CASE(ReadDataBlocksAsFrameZeroFillsOnlyUnreadTailTest)
+{
+    const std::vector<std::vector<unsigned char>> data = {{0x77, 0x22, 0xAB}, {0x01}};
+    auto fileRemover = createAutoRemovableFileWithContent(TempTestFileName, data);
+
+    // NOTE: Frame memory isn't zero-filled on allocation, so the pool gives the dirty chunk back
+    auto memoryPool = std::make_shared<Parallel::LazyMemoryPool>();
+    auto* chunk = static_cast<unsigned char*>(memoryPool->allocate(12));
+    std::fill_n(chunk, 12, 0xFF);
+    memoryPool->deallocate(chunk);
+
+    DataFile dataFile(TempTestFileName, iob::binary | iob::in);
+    auto result = dataFile.readDataBlocksAsFrame(
+        {.firstBlockIdx = 0, .blockSize = 3, .blocksCount = 4, .memoryPool = memoryPool});
+    BOOST_CHECK_EQUAL(createDataFrameWithData(0, {{0x77, 0x22, 0xAB}, {0x01, 0x00, 0x00}}),
+                      result);
+}
+
+BOOST_AUTO_TEST_CASE(ReadDataBlocksAsFrameFromSparseFileTest)
+{
+    // NOTE: file system blocks are usually 4KB, smaller holes may be allocated
+    const size_t blockSize = 4096;
+    const std::vector<unsigned char> dataBlock(blockSize, 0xAB);
+    AutoFileRemover remover(TempTestFileName);
+    {
+        // NOTE: the file is data block, 64 hole blocks, data block, 16 hole blocks and 100 bytes
+        std::ofstream file(TempTestFileName, iob::binary);
+        file.write(reinterpret_cast<const char*>(dataBlock.data()), blockSize);
+        file.seekp(65 * blockSize);
+        file.write(reinterpret_cast<const char*>(dataBlock.data()), blockSize);
+    }
+    fs::resize_file(TempTestFileName, 82 * blockSize + 100);
+
+    DataFile dataFile(TempTestFileName, iob::binary | iob::in);
+    const auto result = dataFile.readDataBlocksAsFrame(
+        {.firstBlockIdx = 0, .blockSize = blockSize, .blocksCount = 100});
+
+    auto expected = DataFrame({.firstBlockIdx = 0, .blockSize = blockSize, .blocksCount = 83});
+    std::copy(dataBlock.begin(), dataBlock.end(), expected.blockAsRange(0).begin());
+    std::copy(dataBlock.begin(), dataBlock.end(), expected.blockAsRange(65).begin());
+    BOOST_CHECK_EQUAL(expected, result);
+    BOOST_CHECK_EQUAL(blockSize - 100, result.paddingSize());
+
+    BOOST_REQUIRE_EQUAL(2, result.holes().size());
+    BOOST_CHECK_EQUAL(1, result.holes().at(0).begin);
+    BOOST_CHECK_EQUAL(65, result.holes().at(0).end);
+    BOOST_CHECK_EQUAL(66, result.holes().at(1).begin);
+    BOOST_CHECK_EQUAL(83, result.holes().at(1).end);
+
+    // NOTE: a frame which lies entirely in a hole
+    const auto holeResult = dataFile.readDataBlocksAsFrame(
+        {.firstBlockIdx = 10, .blockSize = blockSize, .blocksCount = 5});
+    BOOST_CHECK_EQUAL(DataFrame({.firstBlockIdx = 10, .blockSize = blockSize, .blocksCount = 5}),
+                      holeResult);
+    BOOST_REQUIRE_EQUAL(1, holeResult.holes().size());
+    BOOST_CHECK_EQUAL(0, holeResult.holes().front().begin);
+    BOOST_CHECK_EQUAL(5, holeResult.holes().front().end);
+}
+
+BOOST_AUTO_TEST_CASE(ReadDataBlocksAsFrameDirectlyTest)
+{
+    // NOTE: The file ends in the middle of a page, the aligned frames read the tail directly
+    std::vector<unsigned char> data(3 * DirectIoAlignment + 100);
+    for (size_t i = 0; i < data.size(); i++)
+        data[i] = static_cast<unsigned char>(i * 7 + i / 251);
+    auto fileRemover = createAutoRemovableFileWithContent(TempTestFileName, {data});
+    if (!DataFile::canBeReadDirectly(TempTestFileName))
+    {
+        BOOST_TEST_MESSAGE("O_DIRECT isn't supported here, the test is skipped");
+        return;
+    }
+
+    DataFile directFile(TempTestFileName,
+                        iob::binary | iob::in,
+                        DataFile::OptimalStreamBufferSize,
+                        true);
+    DataFile bufferedFile(TempTestFileName, iob::binary | iob::in);
+    const std::vector<DataFrameConfig> configs = {
+        {.firstBlockIdx = 0, .blockSize = DirectIoAlignment, .blocksCount = 2},
+        {.firstBlockIdx = 2, .blockSize = DirectIoAlignment, .blocksCount = 2},
+        {.firstBlockIdx = 0, .blockSize = 1000, .blocksCount = 4096},
+        // NOTE: The frames which can't be aligned are read through the stream
+        {.firstBlockIdx = 1, .blockSize = 1000, .blocksCount = 5},
+        {.firstBlockIdx = 3, .blockSize = 4100, .blocksCount = 1}};
+    for (const auto& config : configs)
+    {
+        const auto result = directFile.readDataBlocksAsFrame(config);
+        const auto expected = bufferedFile.readDataBlocksAsFrame(config);
+        BOOST_CHECK_EQUAL(expected, result);
+        BOOST_CHECK_EQUAL(expected.paddingSize(), result.paddingSize());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(OpenDirectlyUnsupportedFileTest)
+{
+    // NOTE: procfs doesn't support O_DIRECT, the file isn't read through the stream silently
+    const std::string path = "/proc/self/status";
+    if (!fs::exists(path) || DataFile::canBeReadDirectly(path))
+    {
+        BOOST_TEST_MESSAGE("No file without O_DIRECT support is known here, the test is skipped");
+        return;
+    }
+    BOOST_CHECK_THROW(
+        DataFile(path, iob::binary | iob::in, DataFile::OptimalStreamBufferSize, true),
+        std::ifstream::failure);
+    BOOST_CHECK_NO_THROW(DataFile(path, iob::binary | iob::in));
 }
 
 BOOST_AUTO_TEST_CASE(WriteEmptyDataFrameToNonExistingFileTest)
@@ -199,21 +199,198 @@ BOOST_AUTO_TEST_CASE(ReadAllAsDataFramesTest)
     testReadAllAsDataFrames(MB * 97, 3);
 }
 
+BOOST_AUTO_TEST_CASE(DataBlocksInFrameTest)
+{
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(KB), KB);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(3 * KB), 342);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(2 * MB), 1);
+
+    // NOTE: A smaller frame size limit is respected unless a single block doesn't fit
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(KB, 10 * KB + 1), 10);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(3 * KB, 2 * MB), 342);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(3 * KB, KB), 1);
+
+    // NOTE: Aligned frames are cut to a multiple of the alignment, unless it doesn't fit the limit
+    BOOST_CHECK_EQUAL(
+        DataFileWrapper::dataBlocksInFrame(1000, DataFileWrapper::UnlimitedDataFrameSize, 4 * KB),
+        1024);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(3 * KB, 2 * MB, 4 * KB), 340);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(1, 10 * KB, 4 * KB), 8 * KB);
+    BOOST_CHECK_EQUAL(DataFileWrapper::dataBlocksInFrame(MB + 7, 300 * MB, 4 * KB), 1);
+}
+
+BOOST_AUTO_TEST_CASE(ReadAllAsDataFramesOnNodesTest)
+{
+    const size_t dataBlockSize = 3 * KB;
+    boost::asio::thread_pool pool(4);
+    Queue<DataFrame> firstNodeFrames;
+    Queue<DataFrame> secondNodeFrames;
+
+    // NOTE: The frames of both nodes together make the whole file
+    DataFileWrapper reader(PermanentTestFileName, iob::in | iob::binary);
+    reader.readAllAsDataFramesOnNodes(
+        {{.dest = firstNodeFrames, .tasksCount = 2, .cpus = {0}},
+         {.dest = secondNodeFrames, .tasksCount = 1, .arena = std::make_shared<MemoryArena>(MB)}},
+        dataBlockSize,
+        pool);
+    reader.joinAndRethrowExceptions();
+
+    DataFrame frame;
+    while (secondNodeFrames.tryPop(frame))
+        firstNodeFrames.waitAndPush(std::move(frame));
+    const auto result = getAllFramesDataAsVector(firstNodeFrames);
+
+    auto expected = readWholeFile(PermanentTestFileName);
+    expected.resize(ceilDevision(expected.size(), dataBlockSize) * dataBlockSize, 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ReadDataFramesWithRingTest)
+{
+    if (!IoRingFile::isSupported())
+    {
+        BOOST_TEST_MESSAGE("io_uring isn't available, the test is skipped");
+        return;
+    }
+
+    // NOTE: The budget lets only a part of the reads be in flight, the frames are taken by hand
+    const size_t dataBlockSize = 3 * KB;
+    const size_t maxDataFrameSize = 64 * KB;
+    const auto frameSize =
+        DataFileWrapper::dataBlocksInFrame(dataBlockSize, maxDataFrameSize) * dataBlockSize;
+    const auto budget = std::make_shared<MemoryBudget>(3 * frameSize);
+    const auto arena = std::make_shared<MemoryArena>(3 * frameSize);
+    const auto memoryPool = std::make_shared<LazyMemoryPool>(budget, arena);
+    Queue<DataFrame> frames;
+    std::vector<unsigned char> data;
+
+    DataFileWrapper reader(PermanentTestFileName, iob::in | iob::binary);
+    reader.prepareRingReading(dataBlockSize, maxDataFrameSize, 8, arena);
+    for (auto stepResult = StepResult::Progress; stepResult != StepResult::Finished;)
+    {
+        stepResult = reader.readDataFramesWithRing(frames, memoryPool, budget);
+        BOOST_CHECK_LE(budget->bytesInUse(), budget->size());
+        DataFrame frame;
+        while (frames.tryPop(frame))
+        {
+            const auto dataBeginShift = frame.firstBlockIndex() * frame.blockSize();
+            data.resize(std::max(data.size(), dataBeginShift + frame.totalSizeOfAllBlocks()));
+            std::copy(frame.begin(), frame.end(), data.data() + dataBeginShift);
+            // NOTE: The memory goes back to the budget, so the next reads may be queued
+            frame = DataFrame();
+        }
+    }
+
+    auto expected = readWholeFile(PermanentTestFileName);
+    expected.resize(ceilDevision(expected.size(), dataBlockSize) * dataBlockSize, 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(data.begin(), data.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(ReadTruncatedFileWithRingTest)
+{
+    if (!IoRingFile::isSupported())
+    {
+        BOOST_TEST_MESSAGE("io_uring isn't available, the test is skipped");
+        return;
+    }
+
+    // NOTE: The frames are planned for 16 KB, but the file is cut to 2 KB before it's read
+    auto fileRemover =
+        createAutoRemovableFileWithContent(TempTestFileName, {std::vector<unsigned char>(16 * KB)});
+    const auto budget = std::make_shared<MemoryBudget>(16 * KB);
+    const auto arena = std::make_shared<MemoryArena>(16 * KB);
+    const auto memoryPool = std::make_shared<LazyMemoryPool>(budget, arena);
+    Queue<DataFrame> frames;
+
+    DataFileWrapper reader(TempTestFileName, iob::in | iob::binary);
+    reader.prepareRingReading(KB, 4 * KB, 8, arena);
+    fs::resize_file(TempTestFileName, 2 * KB);
+    const auto readAllFrames = [&]() {
+        DataFrame frame;
+        while (reader.readDataFramesWithRing(frames, memoryPool, budget) != StepResult::Finished)
+        {
+            while (frames.tryPop(frame))
+                frame = DataFrame();
+        }
+    };
+    BOOST_CHECK_THROW(readAllFrames(), std::fstream::failure);
+}
+
+BOOST_AUTO_TEST_CASE(MapNextDataFrameTest)
+{
+    const std::vector<unsigned char> data = {0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07};
+    auto fileRemover = createAutoRemovableFileWithContent(TempTestFileName, {data});
+
+    // NOTE: The frames hold 2 blocks of 3 bytes, the last block lies past the end of the file
+    DataFileWrapper reader(TempTestFileName, iob::in | iob::binary);
+    reader.prepareMappedReading(3, 6);
+    const auto first = reader.mapNextDataFrame();
+    BOOST_REQUIRE(first);
+    BOOST_CHECK_EQUAL(first->firstBlockIndex(), 0);
+    BOOST_CHECK_EQUAL(first->blocksCount(), 2);
+    BOOST_CHECK_EQUAL(first->paddingSize(), 0);
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+        first->cbegin(), first->cend(), data.begin(), next(data.begin(), 6));
+
+    const auto second = reader.mapNextDataFrame();
+    BOOST_REQUIRE(second);
+    BOOST_CHECK_EQUAL(second->firstBlockIndex(), 2);
+    BOOST_CHECK_EQUAL(second->blocksCount(), 1);
+    BOOST_CHECK_EQUAL(second->paddingSize(), 2);
+    BOOST_CHECK_EQUAL(*second->cbegin(), data.back());
+
+    BOOST_CHECK(!reader.mapNextDataFrame());
+}
+
+BOOST_AUTO_TEST_CASE(MapTruncatedFileTest)
+{
+    // NOTE: The file is cut after it's mapped, touching the pages past its end would raise SIGBUS
+    auto fileRemover =
+        createAutoRemovableFileWithContent(TempTestFileName, {std::vector<unsigned char>(16 * KB)});
+    DataFileWrapper reader(TempTestFileName, iob::in | iob::binary);
+    reader.prepareMappedReading(KB, 4 * KB);
+    fs::resize_file(TempTestFileName, 2 * KB);
+    BOOST_CHECK_THROW(static_cast<void>(reader.mapNextDataFrame()), std::fstream::failure);
+}
+
+BOOST_AUTO_TEST_CASE(MapSparseFileTest)
+{
+    // NOTE: The file is a data block, 3 hole blocks and a data block, file system blocks are
+    // usually 4KB
+    const size_t blockSize = 4 * KB;
+    const std::vector<unsigned char> dataBlock(blockSize, 0xAB);
+    AutoFileRemover remover(TempTestFileName);
+    {
+        std::ofstream file(TempTestFileName, iob::binary);
+        file.write(reinterpret_cast<const char*>(dataBlock.data()), blockSize);
+        file.seekp(4 * blockSize);
+        file.write(reinterpret_cast<const char*>(dataBlock.data()), blockSize);
+    }
+
+    DataFileWrapper reader(TempTestFileName, iob::in | iob::binary);
+    reader.prepareMappedReading(blockSize, 5 * blockSize);
+    const auto frame = reader.mapNextDataFrame();
+    BOOST_REQUIRE(frame);
+    BOOST_CHECK_EQUAL(frame->blocksCount(), 5);
+    BOOST_REQUIRE_EQUAL(frame->holes().size(), 1);
+    BOOST_CHECK_EQUAL(frame->holes().front().begin, 1);
+    BOOST_CHECK_EQUAL(frame->holes().front().end, 4);
+}
+
 struct WriteAllDataFramesFixture
 {
-    Queue<DataFrame> input;
+    MpscQueue<DataFrame> input;
     boost::asio::thread_pool pool = boost::asio::thread_pool(3);
-    SharedAtomic<bool> finishFlag = makeSharedAtomic<bool>(true);
 };
 
 BOOST_FIXTURE_TEST_CASE(WriteAllDataFramesEmptyQueueTest, WriteAllDataFramesFixture)
 {
     auto fileRemover =
         createAutoRemovableFileWithContent(TempTestFileName, {{0x01, 0x02, 0x03, 0x04}});
+    input.close();
 
     DataFileWrapper writer(TempTestFileName, (iob::out | iob::in | iob::binary));
-    writer.writeAllDataFrames(
-        {.src = input, .hasProducerFinished = finishFlag, .pool = pool, .writingPosShift = 2});
+    writer.writeAllDataFrames({.src = input, .pool = pool, .writingPosShift = 2});
     writer.joinAndRethrowExceptions();
 
     auto result = readWholeFile(TempTestFileName);
@@ -228,10 +405,10 @@ BOOST_FIXTURE_TEST_CASE(WriteAllDataFramesNonEmptyQueueTest, WriteAllDataFramesF
     input.waitAndPush(createDataFrameWithData(2, {{0x22, 0x33}}));
     input.waitAndPush(createDataFrameWithData(0, {{0x01, 0x23}}));
     input.waitAndPush(createDataFrameWithData(1, {{0xF0, 0x3F}}));
+    input.close();
 
     DataFileWrapper writer(TempTestFileName, (iob::out | iob::in | iob::binary));
-    writer.writeAllDataFrames(
-        {.src = input, .hasProducerFinished = finishFlag, .pool = pool, .writingPosShift = 2});
+    writer.writeAllDataFrames({.src = input, .pool = pool, .writingPosShift = 2});
     writer.joinAndRethrowExceptions();
 
     auto result = readWholeFile(TempTestFileName);
@@ -246,10 +423,10 @@ BOOST_FIXTURE_TEST_CASE(WriteAllDataFramesToNonExistingFileTest, WriteAllDataFra
     input.waitAndPush(createDataFrameWithData(2, {{0x22, 0x33}}));
     input.waitAndPush(createDataFrameWithData(0, {{0x01, 0x23}}));
     input.waitAndPush(createDataFrameWithData(1, {{0xF0, 0x3F}}));
+    input.close();
 
     DataFileWrapper writer(TempTestFileName, (iob::out | iob::binary));
-    writer.writeAllDataFrames(
-        {.src = input, .hasProducerFinished = finishFlag, .pool = pool, .writingPosShift = 3});
+    writer.writeAllDataFrames({.src = input, .pool = pool, .writingPosShift = 3});
     writer.joinAndRethrowExceptions();
 
     auto result = readWholeFile(TempTestFileName);
@@ -1,8 +1,13 @@
 ﻿#include <boost/test/unit_test.hpp>
 
 #include "dataframe.h"
+#include "memorysizeliterals.h"
 #include "testtools.h"
 
+#include <algorithm>
+#include <numeric>
+#include <type_traits>
+
 namespace Test
 {
 BOOST_AUTO_TEST_SUITE(DataFrameTestSuite)
@@ -103,5 +108,154 @@ BOOST_FIXTURE_TEST_CASE(DataFrameSetBlocksCountBiggerThenCapacityTest, DataFrame
         return std::string(e.what()) == "The size of the new number of blocks is larger than the capacity";
     });
 }
+
+BOOST_FIXTURE_TEST_CASE(DataFrameCopyZeroFillsUnusedCapacityTest, DataFrameFixture)
+{
+    frame.setBlocksCount(1);
+    DataFrame copiedFrame(frame);
+    copiedFrame.setBlocksCount(2);
+    BOOST_CHECK_EQUAL_COLLECTIONS(copiedFrame.blockAsRange(1).begin(),
+                                  copiedFrame.blockAsRange(1).end(),
+                                  emptyBlock.begin(),
+                                  emptyBlock.end());
+}
+
+BOOST_FIXTURE_TEST_CASE(DataFramePaddingSizeTest, DataFrameFixture)
+{
+    BOOST_CHECK_EQUAL(0, frame.paddingSize());
+
+    frame.setPaddingSize(2);
+    BOOST_CHECK_EQUAL(2, frame.paddingSize());
+    BOOST_CHECK_EQUAL(2, DataFrame(frame).paddingSize());
+
+    frame.setBlocksCount(1);
+    BOOST_CHECK_EQUAL(0, frame.paddingSize());
+
+    BOOST_CHECK_EXCEPTION(frame.setPaddingSize(blockSize), std::out_of_range, [](const std::out_of_range& e) {
+        return std::string(e.what()) == "The padding must be shorter than the last block";
+    });
+}
+
+BOOST_FIXTURE_TEST_CASE(DataFrameHolesTest, DataFrameFixture)
+{
+    BOOST_CHECK(frame.holes().empty());
+
+    frame.setHoles({{1, 2}});
+    BOOST_REQUIRE_EQUAL(1, frame.holes().size());
+    BOOST_CHECK_EQUAL(1, DataFrame(frame).holes().front().begin);
+    BOOST_CHECK_EQUAL(2, DataFrame(frame).holes().front().end);
+
+    frame.setBlocksCount(2);
+    BOOST_CHECK(frame.holes().empty());
+
+    const auto isWrongHolesException = [](const std::out_of_range& e) {
+        return std::string(e.what()) ==
+               "The holes must be sorted, non-empty and lie inside the frame";
+    };
+    BOOST_CHECK_EXCEPTION(frame.setHoles({{1, 3}}), std::out_of_range, isWrongHolesException);
+    BOOST_CHECK_EXCEPTION(frame.setHoles({{1, 1}}), std::out_of_range, isWrongHolesException);
+    BOOST_CHECK_EXCEPTION(
+        frame.setHoles({{1, 2}, {0, 1}}), std::out_of_range, isWrongHolesException);
+}
+
+BOOST_FIXTURE_TEST_CASE(DataFrameViewOfFrameTest, DataFrameFixture)
+{
+    frame.setPaddingSize(1);
+    frame.setHoles({{0, 1}});
+
+    const DataFrameView view(frame);
+    BOOST_CHECK_EQUAL(view.cbegin(), frame.cbegin());
+    BOOST_CHECK_EQUAL(11, view.firstBlockIndex());
+    BOOST_CHECK_EQUAL(blockSize, view.blockSize());
+    BOOST_CHECK_EQUAL(2, view.blocksCount());
+    BOOST_CHECK_EQUAL(frame.capacity() / blockSize, view.blocksCapacity());
+    BOOST_CHECK_EQUAL(1, view.paddingSize());
+    BOOST_REQUIRE_EQUAL(1, view.holes().size());
+    BOOST_CHECK_EQUAL(1, view.holes().front().end);
+    // NOTE: The view borrows the holes of the frame, copies of the view share them
+    BOOST_CHECK_EQUAL(&frame.holes(), &view.holes());
+    const auto copy = view;
+    BOOST_CHECK_EQUAL(&frame.holes(), &copy.holes());
+
+    // NOTE: A view of a temporary frame would dangle
+    static_assert(!std::is_convertible_v<const DataFrame&, DataFrameView>);
+    static_assert(!std::is_constructible_v<DataFrameView, DataFrame&&>);
+
+    const auto block = view.blockAsRange(1);
+    BOOST_CHECK_EQUAL_COLLECTIONS(block.begin(), block.end(), block1.begin(), block1.end());
+}
+
+BOOST_AUTO_TEST_CASE(DataFrameViewOfBorrowedMemoryTest)
+{
+    std::vector<unsigned char> buffer(12);
+    std::iota(buffer.begin(), buffer.end(), 0);
+
+    DataFrameView view(buffer.data(), 5, 4, 3);
+    BOOST_CHECK_EQUAL(5, view.firstBlockIndex());
+    BOOST_CHECK_EQUAL(3, view.blocksCapacity());
+    BOOST_CHECK_EQUAL(12, view.totalSizeOfAllBlocks());
+    BOOST_CHECK_EQUAL(*view.blockAsRange(2).begin(), 8);
+
+    view.setPaddingSize(3);
+    BOOST_CHECK_EQUAL(3, view.paddingSize());
+    BOOST_CHECK_THROW(view.setPaddingSize(4), std::out_of_range);
+    BOOST_CHECK_THROW(view.setHoles({{2, 4}}), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(DataFrameViewSliceTest)
+{
+    std::vector<unsigned char> buffer(20);
+    std::iota(buffer.begin(), buffer.end(), 0);
+    DataFrameView view(buffer.data(), 100, 2, 10);
+    view.setHoles({{1, 3}, {6, 8}});
+    view.setPaddingSize(1);
+
+    const auto middle = view.slice(2, 5);
+    BOOST_CHECK_EQUAL(102, middle.firstBlockIndex());
+    BOOST_CHECK_EQUAL(5, middle.blocksCount());
+    BOOST_CHECK_EQUAL(5, middle.blocksCapacity());
+    BOOST_CHECK_EQUAL(*middle.cbegin(), 4);
+    BOOST_CHECK_EQUAL(0, middle.paddingSize());
+    BOOST_REQUIRE_EQUAL(2, middle.holes().size());
+    BOOST_CHECK_EQUAL(0, middle.holes()[0].begin);
+    BOOST_CHECK_EQUAL(1, middle.holes()[0].end);
+    BOOST_CHECK_EQUAL(4, middle.holes()[1].begin);
+    BOOST_CHECK_EQUAL(5, middle.holes()[1].end);
+
+    const auto tail = view.slice(8, 2);
+    BOOST_CHECK_EQUAL(1, tail.paddingSize());
+    BOOST_CHECK(tail.holes().empty());
+    BOOST_CHECK_EQUAL(0, view.slice(10, 0).blocksCount());
+
+    const auto isWrongSliceException = [](const std::out_of_range& e) {
+        return std::string(e.what()) == "The slice must lie inside the view";
+    };
+    BOOST_CHECK_EXCEPTION(view.slice(9, 2), std::out_of_range, isWrongSliceException);
+    BOOST_CHECK_EXCEPTION(view.slice(11, 0), std::out_of_range, isWrongSliceException);
+}
+
+BOOST_AUTO_TEST_CASE(SharedDataFrameTest)
+{
+    auto budget = std::make_shared<Parallel::MemoryBudget>(MB);
+    auto pool = std::make_shared<Parallel::LazyMemoryPool>(budget);
+    DataFrame frame({.blockSize = 4, .blocksCount = 8, .memoryPool = pool});
+    std::fill(frame.begin(), frame.end(), 0xAB);
+    const auto* data = frame.cbegin();
+
+    // NOTE: The slices share the frame memory, it goes back to the pool with the last of them
+    auto shared = std::move(frame).share();
+    BOOST_CHECK_EQUAL(shared.cbegin(), data);
+    auto firstHalf = shared.slice(0, 4);
+    auto secondHalf = shared.slice(4, 4);
+    shared = DataFrameView();
+    firstHalf = DataFrameView();
+    BOOST_CHECK_EQUAL(budget->bytesInUse(), 32);
+    BOOST_CHECK_EQUAL(secondHalf.cbegin(), data + 16);
+    BOOST_CHECK(std::all_of(
+        secondHalf.cbegin(), secondHalf.cend(), [](unsigned char byte) { return byte == 0xAB; }));
+
+    secondHalf = DataFrameView();
+    BOOST_CHECK_EQUAL(budget->bytesInUse(), 0);
+}
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace Test
@@ -0,0 +1,128 @@
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+#include "ioringfile.h"
+#include "memoryarena.h"
+#include "memorysizeliterals.h"
+#include "testdefs.h"
+#include "testtools.h"
+#include "utils.h"
+
+namespace fs = std::filesystem;
+
+namespace Test
+{
+namespace
+{
+// NOTE: Reads the whole file in pieces of pieceSize with up to queueDepth reads in flight
+std::vector<unsigned char> readWithRing(IoRingFile& file, unsigned char* dest, size_t pieceSize)
+{
+    const auto fileSize = static_cast<size_t>(file.size());
+    std::vector<size_t> readSizes(ceilDevision(fileSize, pieceSize), 0);
+    std::vector<IoRingFile::Completion> completions;
+    size_t nextPiece = 0;
+    while (nextPiece < readSizes.size() || file.inFlightCount() != 0)
+    {
+        for (; nextPiece < readSizes.size(); nextPiece++)
+        {
+            const auto pos = nextPiece * pieceSize;
+            if (!file.prepareRead(
+                    dest + pos, std::min(pieceSize, fileSize - pos), pos, nextPiece))
+                break;
+        }
+        file.submit();
+
+        completions.clear();
+        file.reap(completions, 1);
+        for (const auto& completion : completions)
+        {
+            BOOST_REQUIRE_GE(completion.result, 0);
+            const auto piece = completion.userData;
+            const auto pos = piece * pieceSize;
+            readSizes[piece] += static_cast<size_t>(completion.result);
+            const auto pieceSizeLeft = std::min(pieceSize, fileSize - pos) - readSizes[piece];
+            if (completion.result != 0 && pieceSizeLeft != 0)
+            {
+                BOOST_REQUIRE(file.prepareRead(dest + pos + readSizes[piece],
+                                               pieceSizeLeft,
+                                               pos + readSizes[piece],
+                                               piece));
+            }
+        }
+    }
+    return {dest, dest + fileSize};
+}
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(IoRingFileTestSuite)
+BOOST_AUTO_TEST_CASE(ReadFileTest)
+{
+    if (!IoRingFile::isSupported())
+    {
+        BOOST_TEST_MESSAGE("io_uring isn't available, the test is skipped");
+        return;
+    }
+
+    assert(fs::exists(PermanentTestFileName));
+    const auto expected = readWholeFile(PermanentTestFileName);
+    for (const size_t pieceSize : {size_t(1000), 64 * KB, 5 * MB})
+    {
+        IoRingFile file(PermanentTestFileName, 4);
+        BOOST_REQUIRE_EQUAL(file.size(), expected.size());
+        std::vector<unsigned char> dest(expected.size());
+        const auto result = readWithRing(file, dest.data(), pieceSize);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(ReadIntoRegisteredBufferTest)
+{
+    if (!IoRingFile::isSupported())
+    {
+        BOOST_TEST_MESSAGE("io_uring isn't available, the test is skipped");
+        return;
+    }
+
+    const auto expected = readWholeFile(PermanentTestFileName);
+    Parallel::MemoryArena arena(expected.size() + MB);
+    IoRingFile file(PermanentTestFileName, 8);
+    // NOTE: The reads go through either way, the registration may be refused by the limits
+    file.registerBuffer(arena.data(), arena.size());
+
+    auto* dest = static_cast<unsigned char*>(arena.allocate(expected.size()));
+    const auto result = readWithRing(file, dest, 64 * KB);
+    BOOST_CHECK_EQUAL_COLLECTIONS(result.begin(), result.end(), expected.begin(), expected.end());
+}
+
+BOOST_AUTO_TEST_CASE(QueueDepthTest)
+{
+    if (!IoRingFile::isSupported())
+    {
+        BOOST_TEST_MESSAGE("io_uring isn't available, the test is skipped");
+        return;
+    }
+
+    IoRingFile file(PermanentTestFileName, 2);
+    std::vector<unsigned char> dest(3);
+    BOOST_CHECK(file.prepareRead(&dest[0], 1, 0, 0));
+    BOOST_CHECK(file.prepareRead(&dest[1], 1, 1, 1));
+    BOOST_CHECK(!file.prepareRead(&dest[2], 1, 2, 2));
+    file.submit();
+    BOOST_CHECK_EQUAL(file.inFlightCount(), 2);
+
+    std::vector<IoRingFile::Completion> completions;
+    file.reap(completions, 2);
+    BOOST_CHECK_EQUAL(completions.size(), 2);
+    BOOST_CHECK_EQUAL(file.inFlightCount(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(OpenMissingFileTest)
+{
+    assert(!fs::exists(TempTestFileName));
+    BOOST_CHECK_THROW(IoRingFile file(TempTestFileName, 4), std::fstream::failure);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
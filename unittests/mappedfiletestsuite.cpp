@@ -0,0 +1,45 @@
+#include <boost/test/unit_test.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+#include "mappedfile.h"
+#include "testdefs.h"
+#include "testtools.h"
+
+namespace fs = std::filesystem;
+
+namespace Test
+{
+BOOST_AUTO_TEST_SUITE(MappedFileTestSuite)
+BOOST_AUTO_TEST_CASE(MapFileTest)
+{
+    assert(fs::exists(PermanentTestFileName));
+    MappedFile file(PermanentTestFileName);
+
+    const auto expected = readWholeFile(PermanentTestFileName);
+    BOOST_REQUIRE_EQUAL(file.size(), expected.size());
+    BOOST_CHECK_EQUAL_COLLECTIONS(
+        file.data(), file.data() + file.size(), expected.begin(), expected.end());
+
+    // NOTE: The hints past the end of the file are ignored
+    file.adviseWillNeed(file.size() / 2 + 1, file.size());
+    file.adviseWillNeed(file.size(), file.size());
+}
+
+BOOST_AUTO_TEST_CASE(MapEmptyFileTest)
+{
+    auto fileRemover = createAutoRemovableFileWithContent(TempTestFileName, {});
+
+    MappedFile file(TempTestFileName);
+    BOOST_CHECK_EQUAL(file.size(), 0);
+    file.adviseWillNeed(0, 1);
+}
+
+BOOST_AUTO_TEST_CASE(MapMissingFileTest)
+{
+    assert(!fs::exists(TempTestFileName));
+    BOOST_CHECK_THROW(MappedFile file(TempTestFileName), std::fstream::failure);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
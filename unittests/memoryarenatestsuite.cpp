@@ -0,0 +1,60 @@
+#include "concurentmemorypool.h"
+#include "memoryarena.h"
+#include "memorysizeliterals.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <cstdint>
+
+using namespace Parallel;
+
+namespace Test
+{
+BOOST_AUTO_TEST_SUITE(MemoryArenaTestSuite)
+BOOST_AUTO_TEST_CASE(AllocateUntilExhaustedTest)
+{
+    MemoryArena arena(16 * KB);
+    BOOST_REQUIRE_GE(arena.size(), 16 * KB);
+
+    auto* small = static_cast<unsigned char*>(arena.allocate(10));
+    auto* page = static_cast<unsigned char*>(arena.allocate(4 * KB));
+    BOOST_REQUIRE(small && page);
+    BOOST_CHECK_EQUAL(reinterpret_cast<uintptr_t>(page) % (4 * KB), 0);
+    BOOST_CHECK_GE(page, small + 10);
+
+    // NOTE: The memory is writable
+    std::fill_n(page, 4 * KB, 0xAB);
+
+    while (arena.allocate(4 * KB))
+        ;
+    BOOST_CHECK(arena.allocate(4 * KB) == nullptr);
+    BOOST_CHECK_LE(arena.usedSize(), arena.size());
+}
+
+BOOST_AUTO_TEST_CASE(PrefaultedArenaIsZeroFilledTest)
+{
+    MemoryArena arena(64 * KB, true);
+    auto* memory = static_cast<unsigned char*>(arena.allocate(64 * KB));
+    BOOST_REQUIRE(memory);
+    BOOST_CHECK(std::all_of(memory, memory + 64 * KB, [](auto byte) { return byte == 0; }));
+}
+
+BOOST_AUTO_TEST_CASE(MemoryPoolTakesChunksFromArenaTest)
+{
+    auto arena = std::make_shared<MemoryArena>(8 * KB);
+    LazyMemoryPool pool(nullptr, arena);
+
+    auto* first = static_cast<unsigned char*>(pool.allocate(4 * KB));
+    auto* second = static_cast<unsigned char*>(pool.allocate(4 * KB));
+    BOOST_CHECK_EQUAL(arena->usedSize(), 8 * KB);
+
+    // NOTE: When the arena is exhausted, chunks are taken from the heap
+    auto* third = static_cast<unsigned char*>(pool.allocate(4 * KB));
+    BOOST_REQUIRE(third);
+    pool.deallocate(first);
+    pool.deallocate(second);
+    pool.deallocate(third);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
@@ -0,0 +1,119 @@
+#include "memorybudget.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace Parallel;
+
+namespace Test
+{
+BOOST_AUTO_TEST_SUITE(MemoryBudgetTestSuite)
+BOOST_AUTO_TEST_CASE(CountBytesInUseTest)
+{
+    MemoryBudget budget(100);
+    budget.acquire(60);
+    budget.acquire(40);
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 100);
+
+    budget.release(60);
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 40);
+    budget.release(40);
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(WaitUntilBytesFitTest, *boost::unit_test::timeout(10))
+{
+    MemoryBudget budget(100);
+    budget.acquire(30);
+    budget.acquire(50);
+
+    auto blockedAcquisition = std::async(std::launch::async, [&]() { budget.acquire(40); });
+    BOOST_CHECK(blockedAcquisition.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+
+    // NOTE: 10 released bytes aren't enough yet
+    budget.release(10);
+    BOOST_CHECK(blockedAcquisition.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+
+    budget.release(20);
+    blockedAcquisition.get();
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 90);
+}
+
+BOOST_AUTO_TEST_CASE(OversizedRequestTest, *boost::unit_test::timeout(10))
+{
+    MemoryBudget budget(100);
+    budget.acquire(10);
+
+    auto oversizedAcquisition = std::async(std::launch::async, [&]() { budget.acquire(150); });
+    BOOST_CHECK(oversizedAcquisition.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+
+    // NOTE: The request which never fits is let through alone
+    budget.release(10);
+    oversizedAcquisition.get();
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 150);
+}
+
+BOOST_AUTO_TEST_CASE(ConcurentAcquisitionsTest, *boost::unit_test::timeout(30))
+{
+    const size_t threadsCount = 8;
+    MemoryBudget budget(3 * 64);
+    std::atomic<bool> wasOverBudget = false;
+
+    // NOTE: Boost.Test assertions aren't thread-safe, so the threads only raise the flag
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < threadsCount; i++)
+    {
+        threads.emplace_back([&]() {
+            for (size_t j = 0; j < 10'000; j++)
+            {
+                budget.acquire(64);
+                if (budget.bytesInUse() > budget.size())
+                    wasOverBudget = true;
+                budget.release(64);
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    BOOST_CHECK(!wasOverBudget);
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(ReservationTest)
+{
+    MemoryBudget budget(100);
+    budget.acquire(30);
+    BOOST_CHECK(!budget.tryReserve(80));
+    {
+        auto reservation = budget.tryReserve(50);
+        BOOST_REQUIRE(reservation);
+        BOOST_CHECK_EQUAL(budget.bytesInUse(), 80);
+
+        // NOTE: The reserved bytes are taken without waiting, the rest of them is released with
+        // the reservation
+        budget.acquire(20);
+        BOOST_CHECK_EQUAL(budget.bytesInUse(), 80);
+        budget.acquire(20);
+        BOOST_CHECK_EQUAL(budget.bytesInUse(), 80);
+    }
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 70);
+
+    // NOTE: Another thread has no reservation, so it waits for the budget
+    auto reservation = budget.tryReserve(30);
+    BOOST_REQUIRE(reservation);
+    auto blockedAcquisition = std::async(std::launch::async, [&]() { budget.acquire(10); });
+    BOOST_CHECK(blockedAcquisition.wait_for(std::chrono::milliseconds(100)) ==
+                std::future_status::timeout);
+    budget.release(10);
+    blockedAcquisition.get();
+    BOOST_CHECK_EQUAL(budget.bytesInUse(), 100);
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
@@ -0,0 +1,70 @@
+#include "numatopology.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <vector>
+
+#include <sched.h>
+
+using namespace Parallel;
+
+namespace Test
+{
+BOOST_AUTO_TEST_SUITE(NumaTopologyTestSuite)
+BOOST_AUTO_TEST_CASE(ParseCpuListTest)
+{
+    using Cpus = std::vector<unsigned>;
+    const auto check = [](std::string_view cpuList, const Cpus& expected) {
+        const auto result = parseCpuList(cpuList);
+        BOOST_CHECK_EQUAL_COLLECTIONS(
+            result.begin(), result.end(), expected.begin(), expected.end());
+    };
+
+    check("", Cpus{});
+    check("0", Cpus{0});
+    check("0-3", Cpus{0, 1, 2, 3});
+    check("0-1,4,6-7\n", Cpus{0, 1, 4, 6, 7});
+    check("12,14", Cpus{12, 14});
+
+    // NOTE: A malformed list gives no cpus rather than a part of them
+    check("3-1", Cpus{});
+    check("0,a", Cpus{});
+    check("1-", Cpus{});
+}
+
+BOOST_AUTO_TEST_CASE(NumaNodesHaveCpusTest)
+{
+    const auto nodes = getNumaNodes();
+    for (const auto& node : nodes)
+        BOOST_CHECK(!node.cpus.empty());
+    BOOST_CHECK(std::is_sorted(nodes.begin(), nodes.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.id < rhs.id;
+    }));
+}
+
+BOOST_AUTO_TEST_CASE(ThreadPinningTest)
+{
+    cpu_set_t originalCpus;
+    BOOST_REQUIRE_EQUAL(sched_getaffinity(0, sizeof(originalCpus), &originalCpus), 0);
+    const auto currentCpu = static_cast<unsigned>(sched_getcpu());
+
+    {
+        ThreadPinning pinning({currentCpu});
+        BOOST_REQUIRE(pinning.isPinned());
+
+        cpu_set_t pinnedCpus;
+        BOOST_REQUIRE_EQUAL(sched_getaffinity(0, sizeof(pinnedCpus), &pinnedCpus), 0);
+        BOOST_CHECK_EQUAL(CPU_COUNT(&pinnedCpus), 1);
+        BOOST_CHECK(CPU_ISSET(currentCpu, &pinnedCpus));
+    }
+
+    cpu_set_t restoredCpus;
+    BOOST_REQUIRE_EQUAL(sched_getaffinity(0, sizeof(restoredCpus), &restoredCpus), 0);
+    BOOST_CHECK(CPU_EQUAL(&restoredCpus, &originalCpus));
+
+    ThreadPinning noPinning({});
+    BOOST_CHECK(!noPinning.isPinned());
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test
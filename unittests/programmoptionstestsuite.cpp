@@ -12,14 +12,31 @@ bool operator==(const Options& lhs, const Options& rhs)
 {
     return lhs.blockSize == rhs.blockSize && lhs.inputFile == rhs.inputFile &&
            lhs.isSSD == rhs.isSSD && lhs.outputFile == rhs.outputFile &&
-           lhs.maxRamSize == rhs.maxRamSize;
+           lhs.maxRamSize == rhs.maxRamSize && lhs.checksum == rhs.checksum &&
+           lhs.isMemoryPrefaulted == rhs.isMemoryPrefaulted &&
+           lhs.isNumaAware == rhs.isNumaAware &&
+           lhs.isReadAndHashFused == rhs.isReadAndHashFused &&
+           lhs.isInputMapped == rhs.isInputMapped && lhs.isInputDirect == rhs.isInputDirect &&
+           lhs.ioQueueDepth == rhs.ioQueueDepth &&
+           lhs.threadsCount == rhs.threadsCount && lhs.readersCount == rhs.readersCount &&
+           lhs.hashersCount == rhs.hashersCount;
 }
 
 std::ostream& operator<<(std::ostream& stream, const Options& options)
 {
     return stream << "block size: " << options.blockSize << " input file: " << options.inputFile
                   << " isSSD: " << options.isSSD << " outputFile: " << options.outputFile
-                  << " maxRamSize: " << options.maxRamSize;
+                  << " maxRamSize: " << options.maxRamSize
+                  << " checksum: " << checksumInfo(options.checksum).name
+                  << " isMemoryPrefaulted: " << options.isMemoryPrefaulted
+                  << " isNumaAware: " << options.isNumaAware
+                  << " isReadAndHashFused: " << options.isReadAndHashFused
+                  << " isInputMapped: " << options.isInputMapped
+                  << " isInputDirect: " << options.isInputDirect
+                  << " ioQueueDepth: " << options.ioQueueDepth
+                  << " threadsCount: " << options.threadsCount
+                  << " readersCount: " << options.readersCount
+                  << " hashersCount: " << options.hashersCount;
 }
 
 namespace Test
@@ -119,5 +136,160 @@ BOOST_AUTO_TEST_CASE(DefaultValues)
 
     BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(3, input)));
 }
+
+BOOST_AUTO_TEST_CASE(ChecksumParam)
+{
+    char const* input[4] = {"doesntmatter", "-isomefile.in", "-oanotherfile.out", "-ccrc32c"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .checksum = ChecksumAlgorithm::Crc32C};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(4, input)));
+
+    char const* wrongInput[4] = {"doesntmatter", "-isomefile.in", "-oanotherfile.out", "-cmd5"};
+    BOOST_CHECK_EXCEPTION(getOptionsOrHelpStr(4, wrongInput), po::error, [](const po::error& e) {
+        return std::string(e.what()) ==
+               "wrong checksum algorithm: md5. Correct values: crc8, crc16, crc32, crc32c, crc64";
+    });
+}
+
+BOOST_AUTO_TEST_CASE(PrefaultMemoryParam)
+{
+    char const* input[4] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "--prefault-memory"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .isMemoryPrefaulted = true};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(4, input)));
+}
+
+BOOST_AUTO_TEST_CASE(NumaParam)
+{
+    char const* input[5] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "-tSSD", "--numa"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = true,
+                     .maxRamSize = 3 * GB,
+                     .isNumaAware = true};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(5, input)));
+}
+
+BOOST_AUTO_TEST_CASE(FusedParam)
+{
+    char const* input[5] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "-tSSD", "--fused"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = true,
+                     .maxRamSize = 3 * GB,
+                     .isReadAndHashFused = true};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(5, input)));
+}
+
+BOOST_AUTO_TEST_CASE(MmapParam)
+{
+    char const* input[4] = {"doesntmatter", "-isomefile.in", "-oanotherfile.out", "--mmap"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .isInputMapped = true};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(4, input)));
+}
+
+BOOST_AUTO_TEST_CASE(DirectParam)
+{
+    char const* input[4] = {"doesntmatter", "-isomefile.in", "-oanotherfile.out", "--direct"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .isInputDirect = true};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(4, input)));
+
+    char const* unalignableInput[6] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "-s1000007", "-m1MB", "--direct"};
+    BOOST_CHECK_EXCEPTION(
+        getOptionsOrHelpStr(6, unalignableInput), po::error, [](const po::error& e) {
+            return std::string(e.what()) ==
+                   "--direct can't align the frames of such blocks to 4KB within the max RAM "
+                   "size. Use blocks which are a multiple or a divisor of 4KB";
+        });
+}
+
+BOOST_AUTO_TEST_CASE(IoDepthParam)
+{
+    char const* input[4] = {"doesntmatter", "-isomefile.in", "-oanotherfile.out", "--io-depth=32"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .ioQueueDepth = 32};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(4, input)));
+
+    char const* wrongInput[4] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "--io-depth=5000"};
+    BOOST_CHECK_EXCEPTION(getOptionsOrHelpStr(4, wrongInput), po::error, [](const po::error& e) {
+        return std::string(e.what()) == "wrong io depth: 5000. It must be at most 4096";
+    });
+
+    char const* fusedInput[5] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "--io-depth=32", "--fused"};
+    BOOST_CHECK_EXCEPTION(getOptionsOrHelpStr(5, fusedInput), po::error, [](const po::error& e) {
+        return std::string(e.what()) == "--io-depth can't be used with --fused";
+    });
+}
+
+BOOST_AUTO_TEST_CASE(ThreadsParams)
+{
+    char const* input[6] = {"doesntmatter",
+                            "-isomefile.in",
+                            "-oanotherfile.out",
+                            "--threads=8",
+                            "--readers=2",
+                            "--hashers=5"};
+
+    Options expected{.inputFile = "somefile.in",
+                     .outputFile = "anotherfile.out",
+                     .blockSize = 1 * MB,
+                     .isSSD = false,
+                     .maxRamSize = 3 * GB,
+                     .threadsCount = 8,
+                     .readersCount = 2,
+                     .hashersCount = 5};
+
+    BOOST_CHECK_EQUAL(expected, std::get<Options>(getOptionsOrHelpStr(6, input)));
+
+    char const* wrongInput[4] = {
+        "doesntmatter", "-isomefile.in", "-oanotherfile.out", "--threads=2"};
+    BOOST_CHECK_EXCEPTION(getOptionsOrHelpStr(4, wrongInput), po::error, [](const po::error& e) {
+        return std::string(e.what()) == "wrong threads count: 2. It must be at least 3";
+    });
+}
 BOOST_AUTO_TEST_SUITE_END()
 } // namespace Test
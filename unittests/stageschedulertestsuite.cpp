@@ -0,0 +1,250 @@
+#include "stagescheduler.h"
+#include "concurentqueue.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <stdexcept>
+#include <thread>
+
+using namespace Parallel;
+
+namespace Test
+{
+namespace
+{
+// NOTE: The producer pushes the numbers one per step, the consumer sums them. The queue is small,
+// so the producer waits for place in it and relies on the worker kept for the consumer
+struct Pipeline
+{
+    static constexpr size_t ValuesCount = 10'000;
+
+    boost::asio::thread_pool pool = boost::asio::thread_pool(4);
+    Queue<size_t> queue = Queue<size_t>(2);
+    std::atomic<size_t> nextValue = 0;
+    std::atomic<size_t> sum = 0;
+
+    StepResult produce()
+    {
+        const auto value = nextValue++;
+        if (value >= ValuesCount)
+            return StepResult::Finished;
+        return queue.waitAndPush(value) ? StepResult::Progress : StepResult::Finished;
+    }
+
+    StepResult consume()
+    {
+        size_t value = 0;
+        if (!queue.tryPop(value))
+        {
+            if (!queue.isClosed())
+                return StepResult::NoWork;
+            if (!queue.tryPop(value))
+                return StepResult::Finished;
+        }
+        sum += value;
+        return StepResult::Progress;
+    }
+};
+} // namespace
+
+BOOST_AUTO_TEST_SUITE(StageSchedulerTestSuite)
+BOOST_AUTO_TEST_CASE(RunPipelineTest, *boost::unit_test::timeout(30))
+{
+    for (size_t workersCount : std::initializer_list<size_t>{2, 4})
+    {
+        Pipeline pipeline;
+        Queue<size_t> finishedStages;
+
+        StageScheduler scheduler(workersCount);
+        scheduler.addStage({.step = [&]() { return pipeline.produce(); },
+                            .onFinished = [&]() {
+                                finishedStages.waitAndPush(0);
+                                pipeline.queue.close();
+                            }});
+        scheduler.addStage({.step = [&]() { return pipeline.consume(); },
+                            .maxWorkers = 1,
+                            .onFinished = [&]() { finishedStages.waitAndPush(1); }});
+        scheduler.run(pipeline.pool);
+        scheduler.joinAndRethrowExceptions();
+
+        const auto valuesCount = Pipeline::ValuesCount;
+        BOOST_CHECK_EQUAL(pipeline.sum.load(), valuesCount * (valuesCount - 1) / 2);
+        size_t first = 2;
+        size_t second = 2;
+        BOOST_REQUIRE(finishedStages.tryPop(first) && finishedStages.tryPop(second));
+        BOOST_CHECK_EQUAL(first, 0);
+        BOOST_CHECK_EQUAL(second, 1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(MaxWorkersTest, *boost::unit_test::timeout(30))
+{
+    boost::asio::thread_pool pool(4);
+    std::atomic<size_t> stepsLeft = 2'000;
+    std::atomic<size_t> busyWorkers = 0;
+    std::atomic<bool> isLimitExceeded = false;
+
+    StageScheduler scheduler(4);
+    scheduler.addStage({.step = [&]() {
+                            if (++busyWorkers > 2)
+                                isLimitExceeded = true;
+                            const auto isLast = stepsLeft-- <= 1;
+                            busyWorkers--;
+                            return isLast ? StepResult::Finished : StepResult::Progress;
+                        },
+                        .maxWorkers = 2});
+    scheduler.run(pool);
+    scheduler.joinAndRethrowExceptions();
+    BOOST_CHECK(!isLimitExceeded.load());
+}
+
+BOOST_AUTO_TEST_CASE(WorkerKeptForLastStageTest, *boost::unit_test::timeout(30))
+{
+    // NOTE: Two workers enter the middle stage and wait for the last one. The last stage keeps the
+    // third worker looking for work for a while, it mustn't be let into the top stage then, or a
+    // step there could wait for the last stage as well and nothing would be left to run it
+    constexpr size_t LastStagePolls = 1'000;
+    boost::asio::thread_pool pool(3);
+    std::promise<void> release;
+    const auto released = release.get_future().share();
+    std::atomic<size_t> waitingStepsCnt = 0;
+    std::atomic<size_t> lastStagePolls = 0;
+    std::atomic<bool> isLastWorkerTaken = false;
+
+    StageScheduler scheduler(3);
+    scheduler.addStage({.step = [&]() {
+                            const auto status = released.wait_for(std::chrono::seconds(0));
+                            if (status == std::future_status::ready)
+                                return StepResult::Finished;
+                            if (waitingStepsCnt.load() == 2)
+                                isLastWorkerTaken = true;
+                            return StepResult::NoWork;
+                        }});
+    scheduler.addStage({.step = [&]() {
+                            waitingStepsCnt++;
+                            scheduler.notify();
+                            released.wait();
+                            return StepResult::Finished;
+                        }});
+    scheduler.addStage({.step = [&]() {
+                            if (waitingStepsCnt.load() < 2 || ++lastStagePolls < LastStagePolls)
+                            {
+                                scheduler.notify();
+                                return StepResult::NoWork;
+                            }
+                            release.set_value();
+                            return StepResult::Finished;
+                        },
+                        .maxWorkers = 1});
+    scheduler.run(pool);
+    scheduler.joinAndRethrowExceptions();
+    BOOST_CHECK(!isLastWorkerTaken.load());
+}
+
+BOOST_AUTO_TEST_CASE(SharedPoolTest, *boost::unit_test::timeout(30))
+{
+    // NOTE: The steps don't block, so the parked workers of both schedulers take turns on the
+    // single thread of the pool
+    boost::asio::thread_pool pool(1);
+    std::deque<Pipeline> pipelines(2);
+    std::deque<StageScheduler> schedulers;
+    for (auto& pipeline : pipelines)
+    {
+        auto& scheduler = schedulers.emplace_back(3);
+        scheduler.addStage({.step = [&pipeline]() {
+                                auto value = pipeline.nextValue.load();
+                                if (value >= Pipeline::ValuesCount)
+                                    return StepResult::Finished;
+                                if (!pipeline.queue.tryPush(value))
+                                    return StepResult::NoWork;
+                                pipeline.nextValue++;
+                                return StepResult::Progress;
+                            },
+                            .maxWorkers = 1,
+                            .onFinished = [&pipeline]() { pipeline.queue.close(); }});
+        scheduler.addStage({.step = [&pipeline]() { return pipeline.consume(); }});
+    }
+    for (auto& scheduler : schedulers)
+        scheduler.run(pool);
+    for (auto& scheduler : schedulers)
+        scheduler.joinAndRethrowExceptions();
+
+    const auto valuesCount = Pipeline::ValuesCount;
+    for (const auto& pipeline : pipelines)
+        BOOST_CHECK_EQUAL(pipeline.sum.load(), valuesCount * (valuesCount - 1) / 2);
+}
+
+BOOST_AUTO_TEST_CASE(NotifyTest, *boost::unit_test::timeout(30))
+{
+    // NOTE: The workers are parked or poll until the flag set outside of the scheduler is announced
+    boost::asio::thread_pool pool(2);
+    std::atomic<bool> isReady = false;
+    StageScheduler scheduler(2);
+    scheduler.addStage({.step = [&]() {
+        return isReady.load() ? StepResult::Finished : StepResult::NoWork;
+    }});
+    scheduler.run(pool);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    isReady = true;
+    scheduler.notify();
+    scheduler.joinAndRethrowExceptions();
+}
+
+BOOST_AUTO_TEST_CASE(MissedWakeUpTest, *boost::unit_test::timeout(30))
+{
+    // NOTE: Nobody announces the flag, the last running worker finds it by polling
+    boost::asio::thread_pool pool(2);
+    std::atomic<bool> isReady = false;
+    StageScheduler scheduler(2);
+    scheduler.addStage({.step = [&]() {
+        return isReady.load() ? StepResult::Finished : StepResult::NoWork;
+    }});
+    scheduler.run(pool);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    isReady = true;
+    scheduler.joinAndRethrowExceptions();
+}
+
+BOOST_FIXTURE_TEST_CASE(FailedStepTest, Pipeline, *boost::unit_test::timeout(30))
+{
+    // NOTE: The consumer fails, the producer waiting for place in the queue is woken up by the
+    // consumer closing it, and the stages are aborted when all the workers have stopped
+    std::atomic<size_t> abortedStagesCnt = 0;
+    StageScheduler scheduler(3);
+    scheduler.addStage({.step = [this]() { return produce(); },
+                        .onAbort = [&]() { abortedStagesCnt++; }});
+    scheduler.addStage({.step = [this]() -> StepResult {
+                            queue.close();
+                            throw std::runtime_error("consumer failed");
+                        },
+                        .onAbort = [&]() { abortedStagesCnt++; }});
+    scheduler.run(pool);
+    BOOST_CHECK_THROW(scheduler.joinAndRethrowExceptions(), std::runtime_error);
+    BOOST_CHECK_EQUAL(abortedStagesCnt.load(), 2);
+}
+
+BOOST_AUTO_TEST_CASE(PoolThreadsReservationTest)
+{
+    boost::asio::thread_pool pool(5);
+    boost::asio::thread_pool anotherPool(3);
+    auto first = PoolThreadsReservation::tryReserve(pool, 5, 3);
+    BOOST_REQUIRE(first);
+    BOOST_CHECK(!PoolThreadsReservation::tryReserve(pool, 5, 3));
+    BOOST_CHECK(PoolThreadsReservation::tryReserve(anotherPool, 3, 3));
+
+    // NOTE: The threads are given back by the last owner of the reservation
+    auto moved = std::move(*first);
+    first.reset();
+    BOOST_CHECK(!PoolThreadsReservation::tryReserve(pool, 5, 3));
+    {
+        const auto dropped = std::move(moved);
+    }
+    BOOST_CHECK(PoolThreadsReservation::tryReserve(pool, 5, 5));
+}
+BOOST_AUTO_TEST_SUITE_END()
+} // namespace Test